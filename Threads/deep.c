@@ -0,0 +1,133 @@
+#include <math.h>
+#include "deep.h"
+#include "kernel.h"
+
+// every thread may render a view of its own
+static _Thread_local dd_t center_re, center_im;
+
+// the error free transformations, a + b and a * b as hi + lo
+static inline dd_t two_sum(double a, double b) {
+  double s = a + b, bb = s - a;
+  return (dd_t) {s, (a - (s - bb)) + (b - bb)};
+}
+
+static inline dd_t quick_two_sum(double a, double b) {
+  double s = a + b;
+  return (dd_t) {s, b - (s - a)};
+}
+
+static inline dd_t two_prod(double a, double b) {
+  double p = a * b;
+  return (dd_t) {p, fma(a, b, -p)};
+}
+
+static inline dd_t dd_add(dd_t a, dd_t b) {
+  dd_t s = two_sum(a.hi, b.hi), t = two_sum(a.lo, b.lo);
+  s = quick_two_sum(s.hi, s.lo + t.hi);
+  return quick_two_sum(s.hi, s.lo + t.lo);
+}
+
+static inline dd_t dd_neg(dd_t a) {
+  return (dd_t) {-a.hi, -a.lo};
+}
+
+static inline dd_t dd_sub(dd_t a, dd_t b) {
+  return dd_add(a, dd_neg(b));
+}
+
+static inline dd_t dd_mul(dd_t a, dd_t b) {
+  dd_t p = two_prod(a.hi, b.hi);
+  return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+static inline dd_t dd_mul_d(dd_t a, double b) {
+  dd_t p = two_prod(a.hi, b);
+  return quick_two_sum(p.hi, p.lo + a.lo * b);
+}
+
+// two steps of long division by the leading part of b
+static inline dd_t dd_div(dd_t a, dd_t b) {
+  double q1 = a.hi / b.hi;
+  dd_t r = dd_sub(a, dd_mul_d(b, q1));
+  double q2 = r.hi / b.hi;
+  r = dd_sub(r, dd_mul_d(b, q2));
+  double q3 = r.hi / b.hi;
+  dd_t q = quick_two_sum(q1, q2);
+  return dd_add(q, (dd_t) {q3, 0});
+}
+
+static inline dd_t dd_d(double a) {
+  return (dd_t) {a, 0};
+}
+
+int dd_parse(const char *s, const char **end, dd_t *v) {
+  int neg = *s == '-', digits = 0, decimals = -1;
+  s += *s == '-' || *s == '+';
+  dd_t x = dd_d(0);
+  for (;; ++s) {
+    if (*s == '.' && decimals < 0) {
+      decimals = 0;
+      continue;
+    }
+    if (*s < '0' || *s > '9')
+      break;
+    x = dd_add(dd_mul_d(x, 10), dd_d(*s - '0'));
+    ++digits;
+    decimals += decimals >= 0;
+  }
+  if (digits == 0)
+    return -1;
+  int exp = decimals > 0 ? -decimals : 0;
+  if ((*s == 'e' || *s == 'E') && (s[1] == '-' || s[1] == '+' || (s[1] >= '0' && s[1] <= '9'))) {
+    int eneg = s[1] == '-', e = 0;
+    for (s += 1 + (s[1] == '-' || s[1] == '+'); *s >= '0' && *s <= '9'; ++s)
+      e = e < 10000 ? e * 10 + (*s - '0') : e;
+    exp += eneg ? -e : e;
+  }
+  dd_t scale = dd_d(1);
+  for (int ex = exp < 0 ? -exp : exp; ex > 0; --ex)
+    scale = dd_mul_d(scale, 10);
+  x = exp < 0 ? dd_div(x, scale) : dd_mul(x, scale);
+  *v = neg ? dd_neg(x) : x;
+  *end = s;
+  return 0;
+}
+
+void deep_center(dd_t re, dd_t im) {
+  center_re = re;
+  center_im = im;
+}
+
+// the same tests as the double kernels, made on the leading parts, with
+// c -= p / p' from Horner's rule in double-double
+void kernel_deep(const poly_t *poly, const double *re, const double *im,
+                 int n, char *attr, char *conv) {
+  for (int px = 0; px < n; ++px) {
+    dd_t cr = dd_add(center_re, dd_d(re[px])), ci = dd_add(center_im, dd_d(im[px]));
+    int iter, a = -1;
+    for (iter = 0;; ++iter) {
+      double r2 = cr.hi * cr.hi + ci.hi * ci.hi;
+      if (!(fabs(cr.hi) <= NEWTON_BOUND && fabs(ci.hi) <= NEWTON_BOUND) || iter == MAX_ITER ||
+          (poly->unity && r2 <= NEWTON_EPS * NEWTON_EPS)) {
+        a = ATTR_NONE;
+        break;
+      }
+      if ((a = poly_root_near(poly, cr.hi, ci.hi)) >= 0)
+        break;
+      dd_t pr = dd_d(poly->cre[0]), pi = dd_d(poly->cim[0]), dr = dd_d(0), di = dd_d(0);
+      for (int kx = 1; kx <= poly->degree; ++kx) {
+        dd_t t = dd_add(dd_sub(dd_mul(dr, cr), dd_mul(di, ci)), pr);
+        di = dd_add(dd_add(dd_mul(dr, ci), dd_mul(di, cr)), pi);
+        dr = t;
+        t = dd_add(dd_sub(dd_mul(pr, cr), dd_mul(pi, ci)), dd_d(poly->cre[kx]));
+        pi = dd_add(dd_add(dd_mul(pr, ci), dd_mul(pi, cr)), dd_d(poly->cim[kx]));
+        pr = t;
+      }
+      dd_t d2 = dd_add(dd_mul(dr, dr), dd_mul(di, di));
+      cr = dd_sub(cr, dd_div(dd_add(dd_mul(pr, dr), dd_mul(pi, di)), d2));
+      ci = dd_sub(ci, dd_div(dd_sub(dd_mul(pi, dr), dd_mul(pr, di)), d2));
+    }
+    attr[px] = a;
+    conv[px] = iter < MAX_CONV ? iter : MAX_CONV - 1;
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef DEEP_H
+#define DEEP_H
+
+#include "poly.h"
+
+// views whose pixels are less than DEEP_STEP times their coordinates, or
+// 1, apart need more precision than doubles give
+#define DEEP_STEP 0x1p-36
+
+// a double-double number, hi + lo with |lo| at most half an ulp of hi,
+// good for about 32 significant digits
+typedef struct {
+  double hi, lo;
+} dd_t;
+
+// parse a decimal number such as "-0.743643887037158704752191506114774"
+// or "1.5e-20" from s, end is set past it
+// returns 0 on success, -1 if s does not start with a number
+int dd_parse(const char *s, const char **end, dd_t *v);
+
+// the point the offsets given to kernel_deep in the calling thread are from
+void deep_center(dd_t re, dd_t im);
+
+// a kernel for views too deep for doubles: the points are the center plus
+// the offsets re[ix] + im[ix] i, and Newton's method runs in double-double
+// arithmetic; any polynomial, without SIMD
+void kernel_deep(const poly_t *poly, const double *re, const double *im,
+                 int n, char *attr, char *conv);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef NEWTON_PNG
+#include <zlib.h>
+#endif
+#include "image.h"
+
+// write at offset off, or at the file position if off is negative
+static int write_all(int fd, const char *buf, size_t len, off_t off) {
+  while (len > 0) {
+    ssize_t done = off < 0 ? write(fd, buf, len) : pwrite(fd, buf, len, off);
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0)
+      return -1;
+    buf += done;
+    len -= done;
+    if (off >= 0)
+      off += done;
+  }
+  return 0;
+}
+
+const char *image_ext(int format) {
+  return format == IMAGE_PNG ? "png" : "ppm";
+}
+
+#ifdef NEWTON_PNG
+static void put32(unsigned char *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// a PNG chunk around the len bytes at buf + 8, buf has room for the
+// length and type before and the crc after them
+static size_t png_chunk(unsigned char *buf, const char *type, size_t len) {
+  put32(buf, len);
+  memcpy(buf + 4, type, 4);
+  put32(buf + 8 + len, crc32(0, buf + 4, len + 4));
+  return len + 12;
+}
+
+// scanlines without filter, deflated at the fastest level; every band ends
+// on a byte boundary so the bands of all threads join into one stream
+static int png_pack(const image_t *img, const char *idx, int nrows, int last, pack_t *pack) {
+  size_t line = 1 + 3 * (size_t) img->width;
+  pack->raw = line * nrows;
+  unsigned char *raw = (unsigned char*) malloc(pack->raw);
+  if (raw == NULL)
+    return -1;
+  for (int rx = 0; rx < nrows; ++rx) {
+    unsigned char *p = raw + rx * line;
+    *p++ = 0;
+    for (int jx = 0; jx < img->width; ++jx, p += 3)
+      memcpy(p, img->colors->rgb[(int) idx[(size_t) rx * img->width + jx]], 3);
+  }
+  pack->adler = adler32(1, raw, pack->raw);
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    free(raw);
+    return -1;
+  }
+  size_t cap = deflateBound(&zs, pack->raw) + 16;
+  unsigned char *buf = (unsigned char*) malloc(cap + 12);
+  if (buf == NULL) {
+    deflateEnd(&zs);
+    free(raw);
+    return -1;
+  }
+  zs.next_in = raw;
+  zs.avail_in = pack->raw;
+  zs.next_out = buf + 8;
+  zs.avail_out = cap;
+  int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+  size_t len = cap - zs.avail_out;
+  deflateEnd(&zs);
+  free(raw);
+  if (ret != (last ? Z_STREAM_END : Z_OK)) {
+    free(buf);
+    return -1;
+  }
+  pack->buf = (char*) buf;
+  pack->len = png_chunk(buf, "IDAT", len);
+  return 0;
+}
+#endif
+
+int image_open(image_t *img, const char *path, int format, int width, int height,
+               const colors_t *colors) {
+  img->format = format;
+  img->path = path;
+  img->width = width;
+  img->height = height;
+  img->colors = colors;
+  img->adler = 1;
+  img->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (img->fd < 0) {
+    fprintf(stderr, "cannot create %s\n", path);
+    return -1;
+  }
+  char head[64];
+  size_t len;
+  if (format == IMAGE_PNG) {
+#ifdef NEWTON_PNG
+    // signature, header, and an IDAT chunk with the zlib header alone
+    unsigned char *p = (unsigned char*) head;
+    memcpy(p, "\x89PNG\r\n\x1a\n", 8);
+    put32(p + 16, width);
+    put32(p + 20, height);
+    memcpy(p + 24, "\x08\x02\x00\x00\x00", 5);
+    len = 8 + png_chunk(p + 8, "IHDR", 13);
+    memcpy(p + len + 8, "\x78\x01", 2);
+    len += png_chunk(p + len, "IDAT", 2);
+#else
+    fprintf(stderr, "built without PNG support\n");
+    return -1;
+#endif
+  } else {
+    len = sprintf(head, format == IMAGE_P3 ? "P3\n%d %d \n255\n" : "P6\n%d %d\n255\n",
+                  width, height);
+  }
+  img->head = len;
+  if (write_all(img->fd, head, len, -1) < 0) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+int image_pack(const image_t *img, const char *idx, int nrows, int last, pack_t *pack) {
+  size_t npx = (size_t) nrows * img->width;
+  pack->buf = NULL;
+  pack->adler = 1;
+  pack->raw = 0;
+  int ret = 0;
+  if (img->format == IMAGE_P3) {
+    // 12 bytes a pixel, the last space of every row becomes a newline
+    pack->len = 12 * npx;
+    pack->buf = (char*) malloc(pack->len + 1);
+    if (pack->buf != NULL) {
+      for (size_t px = 0; px < npx; ++px)
+        memcpy(pack->buf + 12 * px, img->colors->text[(int) idx[px]], 12);
+      for (int rx = 1; rx <= nrows; ++rx)
+        pack->buf[12 * (size_t) rx * img->width - 1] = '\n';
+    }
+  } else if (img->format == IMAGE_P6) {
+    pack->len = 3 * npx;
+    pack->buf = (char*) malloc(pack->len + 1);
+    if (pack->buf != NULL)
+      for (size_t px = 0; px < npx; ++px)
+        memcpy(pack->buf + 3 * px, img->colors->rgb[(int) idx[px]], 3);
+  } else {
+#ifdef NEWTON_PNG
+    ret = png_pack(img, idx, nrows, last, pack);
+#endif
+  }
+  if (ret < 0 || pack->buf == NULL) {
+    fprintf(stderr, "cannot pack the rows of %s\n", img->path);
+    return -1;
+  }
+  return 0;
+}
+
+int image_put(image_t *img, int row, pack_t *pack) {
+  // the rows of a PPM have a fixed length, so any band can go to its place
+  off_t off = -1;
+  if (img->format != IMAGE_PNG)
+    off = img->head + (off_t) row * img->width * (img->format == IMAGE_P3 ? 12 : 3);
+  int ret = write_all(img->fd, pack->buf, pack->len, off);
+#ifdef NEWTON_PNG
+  if (img->format == IMAGE_PNG)
+    img->adler = adler32_combine(img->adler, pack->adler, pack->raw);
+#endif
+  free(pack->buf);
+  pack->buf = NULL;
+  if (ret < 0)
+    fprintf(stderr, "cannot write %s\n", img->path);
+  return ret;
+}
+
+int image_close(image_t *img) {
+  int ret = 0;
+#ifdef NEWTON_PNG
+  if (img->format == IMAGE_PNG) {
+    // the zlib trailer in an IDAT chunk of its own, then the end
+    unsigned char tail[16 + 12];
+    put32(tail + 8, img->adler);
+    size_t len = png_chunk(tail, "IDAT", 4);
+    len += png_chunk(tail + len, "IEND", 0);
+    ret = write_all(img->fd, (const char*) tail, len, -1);
+  }
+#endif
+  if (close(img->fd) < 0 || ret < 0) {
+    fprintf(stderr, "cannot write %s\n", img->path);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// output formats: ASCII PPM, binary PPM, and PNG if built with zlib
+enum { IMAGE_P3, IMAGE_P6, IMAGE_PNG };
+
+// a color table: the P3 text of every color, 12 bytes ending in a space,
+// and its bytes
+typedef struct {
+  int ncolors;
+  const char (*text)[12];
+  const unsigned char (*rgb)[3];
+} colors_t;
+
+// an image written as packed bands; packing turns rows of color indices
+// into the bytes of the file, for PNG deflated into an IDAT chunk, and can
+// happen in any thread; PPM bands can be written by several threads in any
+// order, PNG bands only by one thread in order
+typedef struct {
+  int format;
+  int fd;
+  const char *path;
+  int width, height;
+  const colors_t *colors;
+  size_t head;          // length of the header
+  uint32_t adler;       // of the PNG scanlines written so far
+} image_t;
+
+// the bytes of one packed band
+typedef struct {
+  char *buf;
+  size_t len;
+  uint32_t adler;       // of the PNG scanlines of the band
+  size_t raw;           // their length
+} pack_t;
+
+// the file name extension of a format
+const char *image_ext(int format);
+
+// create path and write the header
+// returns 0 on success, -1 after printing an error message
+int image_open(image_t *img, const char *path, int format, int width, int height,
+               const colors_t *colors);
+
+// pack nrows rows of color indices, last is set for the last band
+// returns 0 on success, -1 after printing an error message
+int image_pack(const image_t *img, const char *idx, int nrows, int last, pack_t *pack);
+
+// write a packed band starting at row and free it
+// returns 0 on success, -1 after printing an error message
+int image_put(image_t *img, int row, pack_t *pack);
+
+// finish the file and close it
+int image_close(image_t *img);
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "job.h"
+#include "poly.h"
+
+void job_init(job_t *job) {
+  memset(job, 0, sizeof(*job));
+  job->zoom = 1;
+}
+
+// replace the string at *dst by a copy of src
+static int set_string(char **dst, const char *src) {
+  char *s = strdup(src);
+  if (s == NULL)
+    return -1;
+  free(*dst);
+  *dst = s;
+  return 0;
+}
+
+int job_arg(job_t *job, const char *arg) {
+  char *end;
+  if (strncmp(arg, "-l", 2) == 0) {
+    // -l1000 or -l1920x1080
+    job->width = job->height = strtol(arg+2, &end, 10);
+    if (*end == 'x')
+      job->height = strtol(end+1, &end, 10);
+    return *end == '\0' ? 1 : -1;
+  }
+  if (strncmp(arg, "-c", 2) == 0) {
+    const char *at;
+    if (dd_parse(arg+2, &at, &job->center_re) < 0 || *at != ',' ||
+        dd_parse(at+1, &at, &job->center_im) < 0 || *at != '\0')
+      return -1;
+    return 1;
+  }
+  if (strncmp(arg, "-z", 2) == 0) {
+    job->zoom = strtod(arg+2, &end);
+    return *end == '\0' && job->zoom > 0 ? 1 : -1;
+  }
+  // the last of a degree and coefficients counts
+  if (strncmp(arg, "-p", 2) == 0) {
+    job->degree = 0;
+    return set_string(&job->coeffs, arg+2) < 0 ? -1 : 1;
+  }
+  if (strncmp(arg, "-o", 2) == 0)
+    return arg[2] == '\0' || set_string(&job->name, arg+2) < 0 ? -1 : 1;
+  if (arg[0] == '-')
+    return 0;
+  free(job->coeffs);
+  job->coeffs = NULL;
+  job->degree = strtol(arg, &end, 10);
+  return *end == '\0' ? 1 : -1;
+}
+
+int job_check(const job_t *job, const char *where) {
+  if (job->width < 2 || job->height < 2) {
+    if (where)
+      fprintf(stderr, "%s: the image needs a size of at least 2 x 2\n", where);
+    return -1;
+  }
+  if (job->coeffs == NULL && (job->degree < 1 || job->degree > MAX_DEGREE)) {
+    if (where)
+      fprintf(stderr, "%s: the degree must be between 1 and %d\n", where, MAX_DEGREE);
+    return -1;
+  }
+  return 0;
+}
+
+int jobs_read(const char *path, const job_t *defaults, job_t **jobs) {
+  FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  char *line = NULL, where[64];
+  size_t len = 0;
+  int njobs = 0, cap = 0, ret = 0;
+  *jobs = NULL;
+  for (int lx = 1; getline(&line, &len, file) >= 0; ++lx) {
+    char *arg = strtok(line, " \t\r\n");
+    if (arg == NULL || arg[0] == '#')
+      continue;
+    if (njobs == cap) {
+      cap = cap ? 2 * cap : 64;
+      job_t *more = (job_t*) realloc(*jobs, sizeof(job_t) * cap);
+      if (more == NULL) {
+        fprintf(stderr, "cannot allocate %d jobs\n", cap);
+        ret = -1;
+        break;
+      }
+      *jobs = more;
+    }
+    job_t *job = *jobs + njobs++;
+    *job = *defaults;
+    job->coeffs = job->name = NULL;
+    if ((defaults->coeffs && set_string(&job->coeffs, defaults->coeffs) < 0) ||
+        (defaults->name && set_string(&job->name, defaults->name) < 0)) {
+      fprintf(stderr, "cannot allocate %d jobs\n", njobs);
+      ret = -1;
+      break;
+    }
+    snprintf(where, sizeof(where), "%.40s:%d", path, lx);
+    for (; arg; arg = strtok(NULL, " \t\r\n"))
+      if (job_arg(job, arg) <= 0) {
+        fprintf(stderr, "%s: bad option %s\n", where, arg);
+        ret = -1;
+        break;
+      }
+    if (ret < 0 || (ret = job_check(job, where)) < 0)
+      break;
+  }
+  free(line);
+  if (file != stdin)
+    fclose(file);
+  if (ret < 0) {
+    for (int jx = 0; jx < njobs; ++jx)
+      job_free(*jobs + jx);
+    free(*jobs);
+    *jobs = NULL;
+    return -1;
+  }
+  return njobs;
+}
+
+void job_free(job_t *job) {
+  free(job->coeffs);
+  free(job->name);
+  job->coeffs = job->name = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "deep.h"
+
+// a frame to render: its size and view, its polynomial, and its images
+typedef struct {
+  int width, height;
+  dd_t center_re, center_im;
+  double zoom;
+  int degree;             // the polynomial is x^degree - 1 unless coeffs is set
+  char *coeffs;
+  char *name;             // the images are name_attractors.ppm and
+                          // name_convergence.ppm, or newton_attractors_x7.ppm
+                          // and so on if it is NULL
+} job_t;
+
+// the defaults: a square view of [-2, 2] x [-2, 2] and no size or polynomial
+void job_init(job_t *job);
+
+// take arg into job if it is one of its options: -l[Size | WidthxHeight],
+// -c[Re],[Im], -z[Zoom], -p[Coefficients], -o[Name] or a degree
+// returns 1 if it is, 0 if it is not, -1 if it is malformed
+int job_arg(job_t *job, const char *arg);
+
+// check that job is complete and valid, where is the place to blame in the
+// error message, NULL for none
+// returns 0 if it is, -1 otherwise
+int job_check(const job_t *job, const char *where);
+
+// read the jobs of path, - for the standard input: a job a line, its
+// options separated by blanks starting from the ones of defaults; empty
+// lines and the ones starting with # are skipped
+// returns the number of jobs, -1 after printing an error message
+int jobs_read(const char *path, const job_t *defaults, job_t **jobs);
+
+void job_free(job_t *job);
+
+#endif
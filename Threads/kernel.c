@@ -0,0 +1,459 @@
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+#include "kernel.h"
+
+#define EPS2 (NEWTON_EPS * NEWTON_EPS)
+
+static inline int conv_of(int iter) {
+  return iter < MAX_CONV ? iter : MAX_CONV - 1;
+}
+
+// the kernels are written once with the degree as a compile time constant
+// and instantiated for every degree up to KERNEL_DEGREES, plus once with
+// degree 0 for a degree only known at run time
+//
+// a step is c -= (c^d - 1) / (d c^(d-1)), that is with p = c^(d-1)
+//   c = c (d-1)/d + conj(p) / (d |p|^2)
+// which takes a single reciprocal; p comes from squaring and multiplying
+static inline __attribute__((always_inline))
+void step_scalar(double *cr, double *ci, int degree) {
+  double pr = 1, pi = 0, br = *cr, bi = *ci;
+  for (int e = degree - 1; e > 0; e >>= 1) {
+    if (e & 1) {
+      double t = pr * br - pi * bi;
+      pi = pr * bi + pi * br;
+      pr = t;
+    }
+    if (e > 1) {
+      double t = br * br - bi * bi;
+      bi = 2 * br * bi;
+      br = t;
+    }
+  }
+  double inv = 1 / (degree * (pr * pr + pi * pi)), keep = (degree - 1) / (double) degree;
+  *cr = *cr * keep + pr * inv;
+  *ci = *ci * keep - pi * inv;
+}
+
+// a point within NEWTON_EPS of a root has |c|^2 between NEAR_LO and
+// NEAR_HI, only then the root next to its argument is tested
+#define NEAR_LO ((1 - NEWTON_EPS) * (1 - NEWTON_EPS))
+#define NEAR_HI ((1 + NEWTON_EPS) * (1 + NEWTON_EPS))
+
+static inline int root_near(const poly_t *poly, double cr, double ci, int degree) {
+  long kx = lround(atan2(ci, cr) * degree / (2 * M_PI));
+  kx = kx < 0 ? kx + degree : kx == degree ? 0 : kx;
+  double dr = cr - poly->re[kx], di = ci - poly->im[kx];
+  return dr * dr + di * di <= EPS2 ? kx : -1;
+}
+
+static inline __attribute__((always_inline))
+void iterate_scalar(const poly_t *poly, const double *re, const double *im,
+                    int n, char *attr, char *conv, int degree) {
+  degree = degree ? degree : poly->degree;
+  for (int px = 0; px < n; ++px) {
+    double cr = re[px], ci = im[px];
+    int iter, a = -1;
+    for (iter = 0;; ++iter) {
+      double r2 = cr * cr + ci * ci;
+      if (r2 <= EPS2 || fabs(cr) > NEWTON_BOUND || fabs(ci) > NEWTON_BOUND) {
+        a = ATTR_NONE;
+        break;
+      }
+      if (r2 >= NEAR_LO && r2 <= NEAR_HI && (a = root_near(poly, cr, ci, degree)) >= 0)
+        break;
+      step_scalar(&cr, &ci, degree);
+    }
+    attr[px] = a;
+    conv[px] = conv_of(iter);
+  }
+}
+
+// 4 points per vector, lanes are masked out as they converge and the
+// vector is iterated until all of them have; a last vector that is not
+// full repeats its last point
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline))
+void step_avx2(__m256d *cr, __m256d *ci, int degree) {
+  __m256d pr = _mm256_set1_pd(1.0), pi = _mm256_setzero_pd(), br = *cr, bi = *ci;
+  for (int e = degree - 1; e > 0; e >>= 1) {
+    if (e & 1) {
+      __m256d t = _mm256_sub_pd(_mm256_mul_pd(pr, br), _mm256_mul_pd(pi, bi));
+      pi = _mm256_add_pd(_mm256_mul_pd(pr, bi), _mm256_mul_pd(pi, br));
+      pr = t;
+    }
+    if (e > 1) {
+      __m256d t = _mm256_sub_pd(_mm256_mul_pd(br, br), _mm256_mul_pd(bi, bi));
+      bi = _mm256_mul_pd(_mm256_add_pd(br, br), bi);
+      br = t;
+    }
+  }
+  __m256d p2 = _mm256_add_pd(_mm256_mul_pd(pr, pr), _mm256_mul_pd(pi, pi));
+  __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(degree), p2));
+  __m256d keep = _mm256_set1_pd((degree - 1) / (double) degree);
+  *cr = _mm256_add_pd(_mm256_mul_pd(*cr, keep), _mm256_mul_pd(pr, inv));
+  *ci = _mm256_sub_pd(_mm256_mul_pd(*ci, keep), _mm256_mul_pd(pi, inv));
+}
+
+__attribute__((target("avx2")))
+static inline __attribute__((always_inline))
+void iterate_avx2(const poly_t *poly, const double *re, const double *im,
+                  int n, char *attr, char *conv, int degree) {
+  degree = degree ? degree : poly->degree;
+  const __m256d eps2 = _mm256_set1_pd(EPS2), bound = _mm256_set1_pd(NEWTON_BOUND);
+  const __m256d near_lo = _mm256_set1_pd(NEAR_LO), near_hi = _mm256_set1_pd(NEAR_HI);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  for (int px = 0; px < n; px += 4) {
+    int lanes = n - px < 4 ? n - px : 4;
+    double lr[4], li[4];
+    for (int lx = 0; lx < 4; ++lx) {
+      lr[lx] = re[px + (lx < lanes ? lx : lanes - 1)];
+      li[lx] = im[px + (lx < lanes ? lx : lanes - 1)];
+    }
+    __m256d cr = _mm256_loadu_pd(lr), ci = _mm256_loadu_pd(li);
+    int done = 0xf & ~((1 << lanes) - 1);
+    for (int iter = 0;; ++iter) {
+      __m256d r2 = _mm256_add_pd(_mm256_mul_pd(cr, cr), _mm256_mul_pd(ci, ci));
+      __m256d out = _mm256_or_pd(_mm256_cmp_pd(r2, eps2, _CMP_LE_OQ),
+                    _mm256_or_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, cr), bound, _CMP_GT_OQ),
+                                 _mm256_cmp_pd(_mm256_andnot_pd(sign, ci), bound, _CMP_GT_OQ)));
+      __m256d near = _mm256_and_pd(_mm256_cmp_pd(r2, near_lo, _CMP_GE_OQ),
+                                   _mm256_cmp_pd(r2, near_hi, _CMP_LE_OQ));
+      int fin = _mm256_movemask_pd(out) & ~done;
+      int test = _mm256_movemask_pd(near) & ~done & ~fin;
+      if (fin | test) {
+        _mm256_storeu_pd(lr, cr);
+        _mm256_storeu_pd(li, ci);
+        for (int lx = 0; lx < 4; ++lx) {
+          int a = fin >> lx & 1 ? ATTR_NONE :
+                  test >> lx & 1 ? root_near(poly, lr[lx], li[lx], degree) : -1;
+          if (a >= 0) {
+            attr[px + lx] = a;
+            conv[px + lx] = conv_of(iter);
+            done |= 1 << lx;
+          }
+        }
+        if (done == 0xf)
+          break;
+      }
+
+      // converged lanes keep their value
+      __m256d nr = cr, ni = ci;
+      step_avx2(&nr, &ni, degree);
+      __m256d keep = _mm256_castsi256_pd(_mm256_cmpgt_epi64(
+          _mm256_and_si256(_mm256_set1_epi64x(done), _mm256_setr_epi64x(1, 2, 4, 8)),
+          _mm256_setzero_si256()));
+      cr = _mm256_blendv_pd(nr, cr, keep);
+      ci = _mm256_blendv_pd(ni, ci, keep);
+    }
+  }
+}
+
+// 8 points per vector with mask registers
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline))
+void step_avx512(__m512d *cr, __m512d *ci, int degree, __mmask8 done) {
+  __m512d pr = _mm512_set1_pd(1.0), pi = _mm512_setzero_pd(), br = *cr, bi = *ci;
+  for (int e = degree - 1; e > 0; e >>= 1) {
+    if (e & 1) {
+      __m512d t = _mm512_sub_pd(_mm512_mul_pd(pr, br), _mm512_mul_pd(pi, bi));
+      pi = _mm512_add_pd(_mm512_mul_pd(pr, bi), _mm512_mul_pd(pi, br));
+      pr = t;
+    }
+    if (e > 1) {
+      __m512d t = _mm512_sub_pd(_mm512_mul_pd(br, br), _mm512_mul_pd(bi, bi));
+      bi = _mm512_mul_pd(_mm512_add_pd(br, br), bi);
+      br = t;
+    }
+  }
+  __m512d p2 = _mm512_add_pd(_mm512_mul_pd(pr, pr), _mm512_mul_pd(pi, pi));
+  __m512d inv = _mm512_div_pd(_mm512_set1_pd(1.0), _mm512_mul_pd(_mm512_set1_pd(degree), p2));
+  __m512d keep = _mm512_set1_pd((degree - 1) / (double) degree);
+  // converged lanes keep their value
+  *cr = _mm512_mask_add_pd(*cr, ~done, _mm512_mul_pd(*cr, keep), _mm512_mul_pd(pr, inv));
+  *ci = _mm512_mask_sub_pd(*ci, ~done, _mm512_mul_pd(*ci, keep), _mm512_mul_pd(pi, inv));
+}
+
+__attribute__((target("avx512f")))
+static inline __attribute__((always_inline))
+void iterate_avx512(const poly_t *poly, const double *re, const double *im,
+                    int n, char *attr, char *conv, int degree) {
+  degree = degree ? degree : poly->degree;
+  const __m512d eps2 = _mm512_set1_pd(EPS2), bound = _mm512_set1_pd(NEWTON_BOUND);
+  const __m512d near_lo = _mm512_set1_pd(NEAR_LO), near_hi = _mm512_set1_pd(NEAR_HI);
+  for (int px = 0; px < n; px += 8) {
+    int lanes = n - px < 8 ? n - px : 8;
+    double lr[8], li[8];
+    for (int lx = 0; lx < 8; ++lx) {
+      lr[lx] = re[px + (lx < lanes ? lx : lanes - 1)];
+      li[lx] = im[px + (lx < lanes ? lx : lanes - 1)];
+    }
+    __m512d cr = _mm512_loadu_pd(lr), ci = _mm512_loadu_pd(li);
+    __mmask8 done = 0xff & ~((1 << lanes) - 1);
+    for (int iter = 0;; ++iter) {
+      __m512d r2 = _mm512_add_pd(_mm512_mul_pd(cr, cr), _mm512_mul_pd(ci, ci));
+      __mmask8 fin = (_mm512_cmp_pd_mask(r2, eps2, _CMP_LE_OQ) |
+                      _mm512_cmp_pd_mask(_mm512_abs_pd(cr), bound, _CMP_GT_OQ) |
+                      _mm512_cmp_pd_mask(_mm512_abs_pd(ci), bound, _CMP_GT_OQ)) & ~done;
+      __mmask8 test = _mm512_cmp_pd_mask(r2, near_lo, _CMP_GE_OQ) &
+                      _mm512_cmp_pd_mask(r2, near_hi, _CMP_LE_OQ) & ~done & ~fin;
+      if (fin | test) {
+        _mm512_storeu_pd(lr, cr);
+        _mm512_storeu_pd(li, ci);
+        for (int lx = 0; lx < 8; ++lx) {
+          int a = fin >> lx & 1 ? ATTR_NONE :
+                  test >> lx & 1 ? root_near(poly, lr[lx], li[lx], degree) : -1;
+          if (a >= 0) {
+            attr[px + lx] = a;
+            conv[px + lx] = conv_of(iter);
+            done |= 1 << lx;
+          }
+        }
+        if (done == 0xff)
+          break;
+      }
+      step_avx512(&cr, &ci, degree, done);
+    }
+  }
+}
+
+// any other polynomial: p and p' by Horner's rule, c -= p / p' with one
+// reciprocal of |p'|^2, and the roots looked up in the grid of poly; the
+// bound test is written so that a point gone NaN fails it too
+static void kernel_scalar_general(const poly_t *poly, const double *re, const double *im,
+                                  int n, char *attr, char *conv) {
+  for (int px = 0; px < n; ++px) {
+    double cr = re[px], ci = im[px];
+    int iter, a = -1;
+    for (iter = 0;; ++iter) {
+      if (!(fabs(cr) <= NEWTON_BOUND && fabs(ci) <= NEWTON_BOUND) || iter == MAX_ITER) {
+        a = ATTR_NONE;
+        break;
+      }
+      if ((a = poly_root_near(poly, cr, ci)) >= 0)
+        break;
+      double pr = poly->cre[0], pi = poly->cim[0], dr = 0, di = 0;
+      for (int kx = 1; kx <= poly->degree; ++kx) {
+        double t = dr * cr - di * ci + pr;
+        di = dr * ci + di * cr + pi;
+        dr = t;
+        t = pr * cr - pi * ci + poly->cre[kx];
+        pi = pr * ci + pi * cr + poly->cim[kx];
+        pr = t;
+      }
+      double inv = 1 / (dr * dr + di * di);
+      cr -= (pr * dr + pi * di) * inv;
+      ci -= (pi * dr - pr * di) * inv;
+    }
+    attr[px] = a;
+    conv[px] = conv_of(iter);
+  }
+}
+
+// the lanes whose cell of the root grid holds a root
+__attribute__((target("avx2")))
+static inline int grid_avx2(const poly_t *poly, __m256d cr, __m256d ci) {
+  __m256d fx = _mm256_mul_pd(_mm256_sub_pd(cr, _mm256_set1_pd(poly->gx)), _mm256_set1_pd(poly->ginv));
+  __m256d fy = _mm256_mul_pd(_mm256_sub_pd(ci, _mm256_set1_pd(poly->gy)), _mm256_set1_pd(poly->ginv));
+  __m256d in = _mm256_and_pd(
+      _mm256_and_pd(_mm256_cmp_pd(fx, _mm256_setzero_pd(), _CMP_GE_OQ),
+                    _mm256_cmp_pd(fx, _mm256_set1_pd(poly->gnx), _CMP_LT_OQ)),
+      _mm256_and_pd(_mm256_cmp_pd(fy, _mm256_setzero_pd(), _CMP_GE_OQ),
+                    _mm256_cmp_pd(fy, _mm256_set1_pd(poly->gny), _CMP_LT_OQ)));
+  if (_mm256_movemask_pd(in) == 0)
+    return 0;
+  // lanes outside the grid look at cell 0 and are masked afterwards
+  fx = _mm256_and_pd(fx, in);
+  fy = _mm256_and_pd(fy, in);
+  __m128i cell = _mm_add_epi32(_mm_mullo_epi32(_mm256_cvttpd_epi32(fy), _mm_set1_epi32(poly->gnx)),
+                               _mm256_cvttpd_epi32(fx));
+  __m128i at = _mm_i32gather_epi32(poly->cell, cell, 4);
+  return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(at, _mm_set1_epi32(-1)))) &
+         _mm256_movemask_pd(in);
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2_general(const poly_t *poly, const double *re, const double *im,
+                                int n, char *attr, char *conv) {
+  const __m256d bound = _mm256_set1_pd(NEWTON_BOUND), sign = _mm256_set1_pd(-0.0);
+  for (int px = 0; px < n; px += 4) {
+    int lanes = n - px < 4 ? n - px : 4;
+    double lr[4], li[4];
+    for (int lx = 0; lx < 4; ++lx) {
+      lr[lx] = re[px + (lx < lanes ? lx : lanes - 1)];
+      li[lx] = im[px + (lx < lanes ? lx : lanes - 1)];
+    }
+    __m256d cr = _mm256_loadu_pd(lr), ci = _mm256_loadu_pd(li);
+    int done = 0xf & ~((1 << lanes) - 1);
+    for (int iter = 0;; ++iter) {
+      __m256d out = _mm256_or_pd(
+          _mm256_cmp_pd(_mm256_andnot_pd(sign, cr), bound, _CMP_NLE_UQ),
+          _mm256_cmp_pd(_mm256_andnot_pd(sign, ci), bound, _CMP_NLE_UQ));
+      int fin = (iter == MAX_ITER ? 0xf : _mm256_movemask_pd(out)) & ~done;
+      int test = grid_avx2(poly, cr, ci) & ~done & ~fin;
+      if (fin | test) {
+        _mm256_storeu_pd(lr, cr);
+        _mm256_storeu_pd(li, ci);
+        for (int lx = 0; lx < 4; ++lx) {
+          int a = fin >> lx & 1 ? ATTR_NONE :
+                  test >> lx & 1 ? poly_root_near(poly, lr[lx], li[lx]) : -1;
+          if (a >= 0) {
+            attr[px + lx] = a;
+            conv[px + lx] = conv_of(iter);
+            done |= 1 << lx;
+          }
+        }
+        if (done == 0xf)
+          break;
+      }
+
+      __m256d pr = _mm256_set1_pd(poly->cre[0]), pi = _mm256_set1_pd(poly->cim[0]);
+      __m256d dr = _mm256_setzero_pd(), di = _mm256_setzero_pd();
+      for (int kx = 1; kx <= poly->degree; ++kx) {
+        __m256d t = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(dr, cr), _mm256_mul_pd(di, ci)), pr);
+        di = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dr, ci), _mm256_mul_pd(di, cr)), pi);
+        dr = t;
+        t = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(pr, cr), _mm256_mul_pd(pi, ci)),
+                          _mm256_set1_pd(poly->cre[kx]));
+        pi = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(pr, ci), _mm256_mul_pd(pi, cr)),
+                           _mm256_set1_pd(poly->cim[kx]));
+        pr = t;
+      }
+      __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0),
+                                  _mm256_add_pd(_mm256_mul_pd(dr, dr), _mm256_mul_pd(di, di)));
+      __m256d qr = _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(pr, dr), _mm256_mul_pd(pi, di)), inv);
+      __m256d qi = _mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(pi, dr), _mm256_mul_pd(pr, di)), inv);
+      // converged lanes keep their value
+      __m256d keep = _mm256_castsi256_pd(_mm256_cmpgt_epi64(
+          _mm256_and_si256(_mm256_set1_epi64x(done), _mm256_setr_epi64x(1, 2, 4, 8)),
+          _mm256_setzero_si256()));
+      cr = _mm256_blendv_pd(_mm256_sub_pd(cr, qr), cr, keep);
+      ci = _mm256_blendv_pd(_mm256_sub_pd(ci, qi), ci, keep);
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static inline __mmask8 grid_avx512(const poly_t *poly, __m512d cr, __m512d ci) {
+  __m512d fx = _mm512_mul_pd(_mm512_sub_pd(cr, _mm512_set1_pd(poly->gx)), _mm512_set1_pd(poly->ginv));
+  __m512d fy = _mm512_mul_pd(_mm512_sub_pd(ci, _mm512_set1_pd(poly->gy)), _mm512_set1_pd(poly->ginv));
+  __mmask8 in = _mm512_cmp_pd_mask(fx, _mm512_setzero_pd(), _CMP_GE_OQ) &
+                _mm512_cmp_pd_mask(fx, _mm512_set1_pd(poly->gnx), _CMP_LT_OQ) &
+                _mm512_cmp_pd_mask(fy, _mm512_setzero_pd(), _CMP_GE_OQ) &
+                _mm512_cmp_pd_mask(fy, _mm512_set1_pd(poly->gny), _CMP_LT_OQ);
+  if (in == 0)
+    return 0;
+  // lanes outside the grid are not gathered
+  __m256i cell = _mm256_add_epi32(
+      _mm256_mullo_epi32(_mm512_cvttpd_epi32(fy), _mm256_set1_epi32(poly->gnx)),
+      _mm512_cvttpd_epi32(fx));
+  __m256i at = _mm512_mask_i64gather_epi32(_mm256_set1_epi32(-1), in,
+                                           _mm512_cvtepi32_epi64(cell), poly->cell, 4);
+  return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(at, _mm256_set1_epi32(-1)))) & in;
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512_general(const poly_t *poly, const double *re, const double *im,
+                                  int n, char *attr, char *conv) {
+  const __m512d bound = _mm512_set1_pd(NEWTON_BOUND);
+  for (int px = 0; px < n; px += 8) {
+    int lanes = n - px < 8 ? n - px : 8;
+    double lr[8], li[8];
+    for (int lx = 0; lx < 8; ++lx) {
+      lr[lx] = re[px + (lx < lanes ? lx : lanes - 1)];
+      li[lx] = im[px + (lx < lanes ? lx : lanes - 1)];
+    }
+    __m512d cr = _mm512_loadu_pd(lr), ci = _mm512_loadu_pd(li);
+    __mmask8 done = 0xff & ~((1 << lanes) - 1);
+    for (int iter = 0;; ++iter) {
+      __mmask8 fin = (iter == MAX_ITER ? 0xff :
+                      _mm512_cmp_pd_mask(_mm512_abs_pd(cr), bound, _CMP_NLE_UQ) |
+                      _mm512_cmp_pd_mask(_mm512_abs_pd(ci), bound, _CMP_NLE_UQ)) & ~done;
+      __mmask8 test = grid_avx512(poly, cr, ci) & ~done & ~fin;
+      if (fin | test) {
+        _mm512_storeu_pd(lr, cr);
+        _mm512_storeu_pd(li, ci);
+        for (int lx = 0; lx < 8; ++lx) {
+          int a = fin >> lx & 1 ? ATTR_NONE :
+                  test >> lx & 1 ? poly_root_near(poly, lr[lx], li[lx]) : -1;
+          if (a >= 0) {
+            attr[px + lx] = a;
+            conv[px + lx] = conv_of(iter);
+            done |= 1 << lx;
+          }
+        }
+        if (done == 0xff)
+          break;
+      }
+
+      __m512d pr = _mm512_set1_pd(poly->cre[0]), pi = _mm512_set1_pd(poly->cim[0]);
+      __m512d dr = _mm512_setzero_pd(), di = _mm512_setzero_pd();
+      for (int kx = 1; kx <= poly->degree; ++kx) {
+        __m512d t = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(dr, cr), _mm512_mul_pd(di, ci)), pr);
+        di = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dr, ci), _mm512_mul_pd(di, cr)), pi);
+        dr = t;
+        t = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(pr, cr), _mm512_mul_pd(pi, ci)),
+                          _mm512_set1_pd(poly->cre[kx]));
+        pi = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(pr, ci), _mm512_mul_pd(pi, cr)),
+                           _mm512_set1_pd(poly->cim[kx]));
+        pr = t;
+      }
+      __m512d inv = _mm512_div_pd(_mm512_set1_pd(1.0),
+                                  _mm512_add_pd(_mm512_mul_pd(dr, dr), _mm512_mul_pd(di, di)));
+      __m512d qr = _mm512_mul_pd(_mm512_add_pd(_mm512_mul_pd(pr, dr), _mm512_mul_pd(pi, di)), inv);
+      __m512d qi = _mm512_mul_pd(_mm512_sub_pd(_mm512_mul_pd(pi, dr), _mm512_mul_pd(pr, di)), inv);
+      // converged lanes keep their value
+      cr = _mm512_mask_sub_pd(cr, ~done, cr, qr);
+      ci = _mm512_mask_sub_pd(ci, ~done, ci, qi);
+    }
+  }
+}
+
+#define KERNEL(isa, target, degree)                                              \
+  target static void kernel_##isa##_##degree(const poly_t *poly, const double *re, \
+                                             const double *im, int n, char *attr, \
+                                             char *conv) {                       \
+    iterate_##isa(poly, re, im, n, attr, conv, degree);                         \
+  }
+#define KERNELS(isa, target)                                                     \
+  KERNEL(isa, target, 0) KERNEL(isa, target, 1) KERNEL(isa, target, 2)           \
+  KERNEL(isa, target, 3) KERNEL(isa, target, 4) KERNEL(isa, target, 5)           \
+  KERNEL(isa, target, 6) KERNEL(isa, target, 7) KERNEL(isa, target, 8)           \
+  KERNEL(isa, target, 9)                                                         \
+  static const kernel_fn kernels_##isa[] = {                                     \
+    kernel_##isa##_general, kernel_##isa##_0, kernel_##isa##_1, kernel_##isa##_2, kernel_##isa##_3,      \
+    kernel_##isa##_4, kernel_##isa##_5, kernel_##isa##_6, kernel_##isa##_7,      \
+    kernel_##isa##_8, kernel_##isa##_9,                                          \
+  };
+
+KERNELS(scalar, )
+KERNELS(avx2, __attribute__((target("avx2"))))
+KERNELS(avx512, __attribute__((target("avx512f"))))
+
+kernel_fn kernel_select(const char *name, const poly_t *poly, const char **selected) {
+  static const struct {
+    const char *name;
+    const kernel_fn *fn;
+  } kernels[] = {
+    {"avx512", kernels_avx512},
+    {"avx2", kernels_avx2},
+    {"scalar", kernels_scalar},
+  };
+  __builtin_cpu_init();
+  int supported[] = {
+    __builtin_cpu_supports("avx512f"),
+    __builtin_cpu_supports("avx2"),
+    1,
+  };
+  for (size_t kx = 0; kx < sizeof(kernels) / sizeof(kernels[0]); ++kx)
+    if (supported[kx] && (name == NULL || strcmp(name, kernels[kx].name) == 0)) {
+      if (selected)
+        *selected = kernels[kx].name;
+      // general, x^d - 1 for any d, then x^d - 1 for d = 1, 2, ...
+      if (!poly->unity)
+        return kernels[kx].fn[0];
+      return kernels[kx].fn[poly->degree <= KERNEL_DEGREES ? poly->degree + 1 : 1];
+    }
+  return NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "poly.h"
+
+// iterations are counted up to MAX_CONV - 1
+#define MAX_CONV 50
+
+// x^d - 1 has kernels of its own for the degrees up to KERNEL_DEGREES,
+// where points closer than NEWTON_EPS to the origin are given up on
+#define KERNEL_DEGREES 9
+
+// other polynomials can have attracting cycles, their points are given up
+// on after MAX_ITER iterations or where p' vanishes
+#define MAX_ITER 1000
+
+// attractor index of the points that converge to no root
+#define ATTR_NONE 127
+
+// run Newton's method for poly from the n points re[ix] + im[ix] i, store
+// the index of the root each one converges to in attr and its iterations
+// in conv
+typedef void (*kernel_fn)(const poly_t *poly, const double *re, const double *im,
+                          int n, char *attr, char *conv);
+
+// pick the widest kernel the cpu supports, or the one called name, for
+// the polynomial
+// returns NULL if name is unknown or not supported
+kernel_fn kernel_select(const char *name, const poly_t *poly, const char **selected);
+
+#endif
@@ -2,26 +2,45 @@
 #include <stdio.h>
 #include <threads.h>
 #include <string.h>
-#include <complex.h>
 #include <math.h>
-
-// number of threads, picture size and exponent degree
-int nthrds, img_size, degree;
-
-// epsilon for breaking the computation loop
-const double eps = 0.001;
-const long upper_bound = 10000000000;
-const int max_conv = 50;
-
-// roots for the exponent expression
-double complex **roots;
+#include "kernel.h"
+#include "sched.h"
+#include "image.h"
+#include "trace.h"
+#include "deep.h"
+#include "job.h"
+#include "numa.h"
+
+// number of compute threads and writing threads, the writers split
+// between the two images
+int nthrds, nwriters = 2;
+// the memory for the bands in flight of a frame in MiB, 0 for all of them
+int mem_mib;
+// the format of the images
+int format = IMAGE_P3;
+// render by tracing the borders of the basins, compare with iterating
+// every pixel
+int trace, verify;
+// compute only the pixels that are not mirror images of others
+int symmetry;
+// pin the threads to cores or NUMA nodes
+int affinity = NUMA_OFF;
+// the kernel asked for, NULL for the widest one
+const char *kernel_name;
+
+// the jobs, every one rendered into a frame
+job_t *jobs;
+int njobs;
 
 // color map for drawing attractor image
 char *colormap[10] = {
 		      "180 000 030", "000 180 030", "000 030 180", "000 190 180", "180 000 175",
 		      "180 255 000", "155 170 180", "070 050 000", "150 060 000", "000 150 060"
 };
-char *colormap_conv[50] = {
+// colors of the attractors by root, ATTR_NONE has the last color of colormap
+char palette[ATTR_NONE + 1][12];
+unsigned char palette_rgb[ATTR_NONE + 1][3];
+char *colormap_conv[MAX_CONV] = {
 			   "005 005 005 ", "010 010 010 ", "015 015 015 ", "020 020 020 ", "025 025 025 ",
 			   "030 030 030 ", "035 035 035 ", "040 040 040 ", "045 045 045 ", "050 050 050 ",
 			   "056 056 056 ", "061 061 061 ", "066 066 066 ", "071 071 071 ", "076 076 076 ",
@@ -33,313 +52,567 @@ char *colormap_conv[50] = {
 			   "209 209 209 ", "214 214 214 ", "219 219 219 ", "224 224 224 ", "229 229 229 ",
 			   "234 234 234 ", "239 239 239 ", "244 244 244 ", "249 249 249 ", "255 255 255 "
 };
-
-// argument type for computation thread
+char conv_text[MAX_CONV][12];
+unsigned char conv_rgb[MAX_CONV][3];
+colors_t attr_colors = {ATTR_NONE + 1, palette, palette_rgb};
+colors_t conv_colors = {MAX_CONV, conv_text, conv_rgb};
+
+// a frame being rendered; the frames of jobs j, j + nslots, ... take
+// turns in a slot and keep its buffers, the threads go through the jobs
+// in order and every one leaves a frame as soon as it has nothing left to
+// do there, so that small frames are rendered side by side
 typedef struct {
-  int thrd_idx;
-  char *attr;
-  char *conv;
-  char *row_done;
-} comp_thrd_info_t;
+  int job;                // -1 if the slot is free
+  int ready;              // set up for the threads
+  int users;              // threads that have not left it yet
+
+  poly_t poly;            // x^degree - 1 unless given by its coefficients
+  kernel_fn kernel;       // the kernel iterating its pixels
+  int deep;
+  dd_t center_re, center_im;
+  int width, height;
+  // the columns right of the middle are the mirror images of the ones left
+  // of it, the rows of the lower half those of the upper one
+  int sym_cols, sym_rows;
+  // the real part of every row and the imaginary part of every column, for
+  // deep views their offsets from the center
+  double *row_re, *col_im;
+  char *attr, *conv;      // a window of bands
+  pack_t *attrpacks, *convpacks;
+  pack_t *attrmirror, *convmirror; // the mirror images of the bands
+  size_t row_cap, col_cap, pixel_cap, pack_cap, mirror_cap;
+  char *attrname, *convname;
+  image_t attrimg, convimg;
+  sched_t sched;
+  // the pixels iterated and the ones that differ when verifying
+  atomic_long iterated, attr_diffs, conv_diffs, conv_error;
+} frame_t;
+
+frame_t *frames;
+int nslots;
+mtx_t frames_mtx;
+cnd_t frames_cnd;
+
+// grow the buffer at *buf to hold n elements of size bytes, cap is the
+// number it holds
+static void *grow(void *buf, size_t *cap, size_t n, size_t size) {
+  if (n <= *cap)
+    return buf;
+  void *more = realloc(buf, n * size);
+  if (more == NULL) {
+    fprintf(stderr, "cannot allocate %zu bytes\n", n * size);
+    exit(1);
+  }
+  *cap = n;
+  return more;
+}
 
-// argument type for writing thread
-typedef struct {
-  FILE *attrfile;
-  FILE *convfile;
-  char *attr;
-  char *conv;
-  char *row_done;
-} write_thrd_info_t;
+// set the frame up for job: the polynomial, the coordinates of the view,
+// the images and the bands in flight
+void frame_setup(frame_t *frame, const job_t *job) {
+  if ((job->coeffs ? poly_parse(&frame->poly, job->coeffs)
+                   : poly_unity(&frame->poly, job->degree)) < 0)
+    exit(1);
+  int width = frame->width = job->width, height = frame->height = job->height;
+
+  // the coordinates of the rows and columns, half a pixel step apart from
+  // the center on each side; once a step is below DEEP_STEP of the
+  // coordinates, the center is kept in double-double and the rows and
+  // columns only hold the offsets from it
+  int shorter = width < height ? width : height;
+  double half = 2 / job->zoom / (shorter - 1);
+  double extent = fmax(1, fmax(fabs(job->center_re.hi), fabs(job->center_im.hi)));
+  int deep = 2 * half < DEEP_STEP * extent || (kernel_name && strcmp(kernel_name, "dd") == 0);
+  frame->deep = deep;
+  frame->center_re = job->center_re;
+  frame->center_im = job->center_im;
+  frame->row_re = (double*) grow(frame->row_re, &frame->row_cap, height, sizeof(double));
+  frame->col_im = (double*) grow(frame->col_im, &frame->col_cap, width, sizeof(double));
+  for (int ix = 0; ix < height; ix++)
+    frame->row_re[ix] = (deep ? 0 : job->center_re.hi) + (2 * ix - (height - 1)) * half;
+  for (int jx = 0; jx < width; jx++)
+    frame->col_im[jx] = (deep ? 0 : job->center_im.hi) + (2 * jx - (width - 1)) * half;
+  frame->kernel = deep ? kernel_deep : kernel_select(kernel_name, &frame->poly, NULL);
+  if (frame->kernel == NULL) {
+    fprintf(stderr, "kernel %s not available\n", kernel_name);
+    exit(1);
+  }
 
-// given a complex number, calculate which root it will be converged to
-// and set the attr and conv with the specific value
-void compute(double complex c, char *attr, char *conv) {
-  int iter;
-  // start iteration
-  for (iter = 0, *attr = -1;;iter++) {
-    // break when x is closer than 10^-3 to the origin
-    if (creal(c)*creal(c) + cimag(c)*cimag(c) <= eps * eps) {
-      *attr = 9;
-      break;
-    }
-    // break when the absolute value of the real and imaginary part of
-    // x reaches an upper bound
-    if (fabs(creal(c)) > upper_bound || fabs(cimag(c)) > upper_bound) {
-      *attr = 9;
-      break;
-    }
-    // If x_i is closer than 10^-3 to one of the roots of f(x),
-    // then abort the iteration.
-    double complex *rs = roots[degree-1];
-    double complex diff;
-    for (int ix = 0; ix < degree; ix++) {
-      diff = c - rs[ix];
-      if (creal(diff)*creal(diff) + cimag(diff)*cimag(diff) <= eps * eps) {
-	*attr = ix;
-	break;
-      }
-    }
-    if (*attr != -1)
-      break;
+  // x^d - 1 is symmetric about the real axis, for even d about the
+  // imaginary axis as well, and the kernels map the mirror image of a
+  // point to the mirror image of its root with the same iterations; so a
+  // view centered on the real axis computes only the columns up to the
+  // middle, one centered at 0 only the upper rows as well; PNG is written
+  // in order, so it mirrors only the columns
+  frame->sym_cols = symmetry && frame->poly.unity &&
+                    job->center_im.hi == 0 && job->center_im.lo == 0;
+  frame->sym_rows = frame->sym_cols && frame->poly.degree % 2 == 0 && format != IMAGE_PNG &&
+                    job->center_re.hi == 0 && job->center_re.lo == 0;
+  int rows = frame->sym_rows ? (height + 1) / 2 : height;
+  int cols = frame->sym_cols ? (width + 1) / 2 : width;
+
+  // create attractor file and convergence file
+  // and write the required file header
+  const char *ext = image_ext(format);
+  size_t len = (job->name ? strlen(job->name) : 16) + 32;
+  frame->attrname = (char*) malloc(len);
+  frame->convname = (char*) malloc(len);
+  if (frame->attrname == NULL || frame->convname == NULL) {
+    fprintf(stderr, "cannot allocate %zu bytes\n", len);
+    exit(1);
+  }
+  if (job->name) {
+    snprintf(frame->attrname, len, "%s_attractors.%s", job->name, ext);
+    snprintf(frame->convname, len, "%s_convergence.%s", job->name, ext);
+  } else {
+    snprintf(frame->attrname, len, "newton_attractors_x%d.%s", frame->poly.degree, ext);
+    snprintf(frame->convname, len, "newton_convergence_x%d.%s", frame->poly.degree, ext);
+  }
+  if (image_open(&frame->attrimg, frame->attrname, format, width, height, &attr_colors) < 0 ||
+      image_open(&frame->convimg, frame->convname, format, width, height, &conv_colors) < 0)
+    exit(1);
 
-    double complex fx, dfx;
-    switch ( degree ) {
-    case 1: // hardcoded computation
-      c -= c-1;
-      break;
-    case 2: // hardcoded computation
-      c -= (c * c - 1) / (2 * c);
-      break;
-    case 3:
-      c -= (c * c * c - 1) /(3 * c * c);
-      break;
-    case 4:
-      c -=(c * c * c * c - 1) / (4 * c * c * c);
-      break;
-    case 5:
-      c -=(c * c * c * c * c - 1) / (5 * c * c * c * c);
-      break;
-    case 6:
-      c -=(c * c * c * c * c * c - 1) / ( 6 * c * c * c * c * c);
-      break;
-    case 7:
-      c -= (c * c * c * c * c * c * c -1) / (7 * c * c * c * c * c * c);
-      break;
-    case 8:
-      c -=(c * c * c * c * c * c * c * c -1) / (8 * c * c * c * c * c * c * c);
-      break;
-    case 9:
-      c -=(c * c * c * c * c * c * c * c * c - 1) / (9 * c * c * c * c * c *c * c *c);
-      break; 
-    default:
-      fprintf(stderr, "unexpected degree\n");
+  // the bands in flight, all of them unless -m bounds their memory: a band
+  // takes a byte a pixel in attr and conv and its packed bytes in both
+  // images until they are written, for PNG the raw scanlines as well, and
+  // those of its mirror image
+  int band_rows = trace ? TRACE_ROWS : SCHED_ROWS;
+  int nbands = (rows + band_rows - 1) / band_rows;
+  int window = nbands;
+  if (mem_mib > 0) {
+    int pack_bytes = format == IMAGE_P3 ? 2 * 12 : format == IMAGE_P6 ? 2 * 3 : 4 * 3;
+    int pixel_bytes = 2 + (frame->sym_rows ? 2 : 1) * pack_bytes;
+    size_t band_bytes = (size_t) band_rows * width * pixel_bytes;
+    size_t fit = ((size_t) mem_mib << 20) / band_bytes;
+    if (fit < 1) {
+      fprintf(stderr, "-m%d has no room for a band of %zu bytes\n", mem_mib, band_bytes);
       exit(1);
     }
+    window = fit < (size_t) nbands ? fit : nbands;
+  }
 
+  // attr and conv hold window bands of width pixels; the buffers of a
+  // pair always have the same capacity
+  size_t pixel_cap = frame->pixel_cap, pack_cap = frame->pack_cap;
+  frame->attr = (char*) grow(frame->attr, &pixel_cap, (size_t) window * band_rows * width, 1);
+  frame->conv = (char*) grow(frame->conv, &frame->pixel_cap, (size_t) window * band_rows * width, 1);
+  frame->attrpacks = (pack_t*) grow(frame->attrpacks, &pack_cap, nbands, sizeof(pack_t));
+  frame->convpacks = (pack_t*) grow(frame->convpacks, &frame->pack_cap, nbands, sizeof(pack_t));
+  if (frame->sym_rows) {
+    size_t mirror_cap = frame->mirror_cap;
+    frame->attrmirror = (pack_t*) grow(frame->attrmirror, &mirror_cap, nbands, sizeof(pack_t));
+    frame->convmirror = (pack_t*) grow(frame->convmirror, &frame->mirror_cap, nbands, sizeof(pack_t));
   }
-  // set convergence value to the number of iterations
-  *conv = iter < max_conv ? iter : max_conv-1;
+  // Synchronization of compute and write threads through tiles, every band
+  // is written once for each image.
+  if (sched_init(&frame->sched, nthrds, rows, cols, band_rows, window, 2) < 0)
+    exit(1);
+  atomic_init(&frame->iterated, 0);
+  atomic_init(&frame->attr_diffs, 0);
+  atomic_init(&frame->conv_diffs, 0);
+  atomic_init(&frame->conv_error, 0);
+}
 
+// close the images of the frame once all of it is written
+void frame_finish(frame_t *frame) {
+  if (image_close(&frame->attrimg) < 0 || image_close(&frame->convimg) < 0)
+    exit(1);
+  // the bands were first touched by the threads computing them
+  if (affinity != NUMA_OFF) {
+    numa_report(frame->attrname, frame->attr, frame->pixel_cap);
+    numa_report(frame->convname, frame->conv, frame->pixel_cap);
+  }
+  if (verify) {
+    double npixels = (double) frame->sched.rows * frame->sched.cols;
+    fprintf(stderr, "%s: iterated %.1f%% of the pixels, attractors differ in %ld,"
+            " iterations in %ld, by %.4f on average\n", frame->attrname,
+            100 * frame->iterated / npixels, (long) frame->attr_diffs,
+            (long) frame->conv_diffs, frame->conv_error / npixels);
+  }
+  free(frame->attrname);
+  free(frame->convname);
+  sched_free(&frame->sched);
+  poly_free(&frame->poly);
 }
 
-// compute thread
-int comp_thrd(void *args) {
-  // parse arguments
-  const comp_thrd_info_t *thrd_info  = (comp_thrd_info_t*) args;
-  int thrd_idx = thrd_info->thrd_idx;
-  char *attr = thrd_info->attr;
-  char *conv = thrd_info->conv;
+// the frame of job, the first thread to get there sets it up once the
+// frame before it in the slot is done
+frame_t *frame_enter(int job) {
+  frame_t *frame = frames + job % nslots;
+  mtx_lock(&frames_mtx);
+  while (frame->job != job && frame->job != -1)
+    cnd_wait(&frames_cnd, &frames_mtx);
+  if (frame->job == -1) {
+    frame->job = job;
+    frame->ready = 0;
+    frame->users = nthrds + nwriters;
+    mtx_unlock(&frames_mtx);
+    frame_setup(frame, jobs + job);
+    mtx_lock(&frames_mtx);
+    frame->ready = 1;
+    cnd_broadcast(&frames_cnd);
+  }
+  while (!frame->ready)
+    cnd_wait(&frames_cnd, &frames_mtx);
+  mtx_unlock(&frames_mtx);
+  return frame;
+}
+
+// the last thread to leave the frame finishes it and frees its slot
+void frame_leave(frame_t *frame) {
+  mtx_lock(&frames_mtx);
+  int last = --frame->users == 0;
+  mtx_unlock(&frames_mtx);
+  if (!last)
+    return;
+  frame_finish(frame);
+  mtx_lock(&frames_mtx);
+  frame->job = -1;
+  cnd_broadcast(&frames_cnd);
+  mtx_unlock(&frames_mtx);
+}
+
+// the root of the mirror image of a point attracted by root a, about the
+// real axis, or about the imaginary one if flip is set
+static inline char mirror_attr(int a, int degree, int flip) {
+  if (a == ATTR_NONE)
+    return a;
+  return flip ? (degree / 2 - a + degree) % degree : (degree - a) % degree;
+}
 
-  // process rows
-  for(int ix = thrd_idx; ix < img_size; ix += nthrds) {
-    // process each point
-    // the value for the real part of the complex number, reduced to [-2, 2]
-    double re = ix * (2.0 - (-2.0)) / (img_size - 1.0) - 2.0;
-    for (int jx = 0; jx < img_size; jx++) {
-      // the value for the imaginary part of the complex number, reduced to [-2, 2]
-      double im = jx * (2.0 - (-2.0)) / (img_size - 1.0) - 2.0;
-      // construct the complex number
-      double complex c = re + im * I;
-      compute(c, attr + ix * img_size + jx, conv + ix * img_size + jx);
+// fill the columns right of the middle of nrows rows of the band
+static void mirror_cols(const frame_t *frame, char *attr, char *conv, int nrows) {
+  int width = frame->width, degree = frame->poly.degree;
+  for (int ix = 0; ix < nrows; ix++) {
+    char *row_attr = attr + (size_t) ix * width, *row_conv = conv + (size_t) ix * width;
+    for (int jx = (width + 1) / 2; jx < width; jx++) {
+      row_attr[jx] = mirror_attr(row_attr[width - 1 - jx], degree, 0);
+      row_conv[jx] = row_conv[width - 1 - jx];
     }
-    thrd_info->row_done[ix] = 1;
   }
 }
 
-// writing thread
-int writefile(void *args) {
-  // parse arguments
-  const write_thrd_info_t *thrd_info  = (write_thrd_info_t*) args;
-  FILE *attrfile = thrd_info->attrfile;
-  FILE *convfile = thrd_info->convfile;
+// the rows of the lower half mirroring band, they start at *first; the
+// middle row of an odd height has no mirror image
+static int mirror_span(const frame_t *frame, int band, int *first) {
+  int row0 = band * frame->sched.band_rows, row1 = row0 + frame->sched.band_rows;
+  row1 = row1 < frame->height / 2 ? row1 : frame->height / 2;
+  *first = frame->height - row1;
+  return row1 - row0;
+}
 
-  struct timespec sleep_timespec;
-  sleep_timespec.tv_sec = 0;
-  sleep_timespec.tv_nsec = 100;
+// pack the mirror image of band, whose rows are in attr and conv, with tmp
+// taking a band of both
+static void mirror_rows(frame_t *frame, int band, const char *attr, const char *conv, char *tmp) {
+  int width = frame->width, degree = frame->poly.degree, first;
+  int nrows = mirror_span(frame, band, &first);
+  if (nrows <= 0)
+    return;
+  char *tmp_attr = tmp, *tmp_conv = tmp + (size_t) nrows * width;
+  for (int ix = 0; ix < nrows; ix++) {
+    // row first + ix mirrors row height - 1 - first - ix
+    size_t from = (size_t) (frame->height - 1 - first - ix - band * frame->sched.band_rows) * width;
+    size_t to = (size_t) ix * width;
+    for (int jx = 0; jx < width; jx++)
+      tmp_attr[to + jx] = mirror_attr(attr[from + jx], degree, 1);
+    memcpy(tmp_conv + to, conv + from, width);
+  }
+  if (image_pack(&frame->attrimg, tmp_attr, nrows, 0, frame->attrmirror + band) < 0 ||
+      image_pack(&frame->convimg, tmp_conv, nrows, 0, frame->convmirror + band) < 0)
+    exit(1);
+}
 
-  // representing the row string of attractor image and convergence image
-  char attr_color_row[12 * img_size];
-  char con_color_row[12 * img_size];
-  // write row by row
-  for (int ix = 0; ix < img_size; ix++) {
-    // only write a row when a compute thread finish this row, otherwise wait for timespec
-    while (!thrd_info->row_done[ix]) {
-      nanosleep(&sleep_timespec, NULL);
-      continue;
-    }
-    // get the row from the attractor array and convergence array
-    char *attr_row = thrd_info->attr + ix * img_size;
-    char *conv_row = thrd_info->conv + ix * img_size;
-    // write pixel by pixel
-    for (int jx = 0; jx < img_size; jx++) {
-      // choose the color according to the attr and conv value
-      char *attr_color = colormap[attr_row[jx]];
-      memcpy(attr_color_row+12*jx, attr_color, 12);
+// compute the tiles of a frame, own ones first, then stolen ones
+void comp_frame(frame_t *frame, int thrd_idx) {
+  sched_t *sched = &frame->sched;
+  const poly_t *poly = &frame->poly;
+  kernel_fn kernel = frame->kernel;
+  int width = frame->width;
+  char *attr = frame->attr, *conv = frame->conv;
+  // the deep kernel takes the center of this thread's frame
+  if (frame->deep)
+    deep_center(frame->center_re, frame->center_im);
+
+  double re[SCHED_COLS];
+  // the tile iterated in full when verifying
+  char check_attr[verify ? TRACE_ROWS * SCHED_COLS : 1];
+  char check_conv[verify ? TRACE_ROWS * SCHED_COLS : 1];
+  // the mirror image of a band
+  char *tmp = NULL;
+  if (frame->sym_rows && (tmp = (char*) malloc((size_t) 2 * sched->band_rows * width)) == NULL) {
+    fprintf(stderr, "cannot allocate %zu bytes\n", (size_t) 2 * sched->band_rows * width);
+    exit(1);
+  }
 
-      char *conv_color = colormap_conv[conv_row[jx]];
-      memcpy(con_color_row+12*jx, conv_color, 12);
+  unsigned seed = thrd_idx + 1;
+  for (long tile; (tile = sched_next(sched, thrd_idx, &seed)) >= 0;) {
+    int row0, row1, col0, col1;
+    sched_tile(sched, tile, &row0, &row1, &col0, &col1);
+    int ncols = col1 - col0;
+    // the bands in flight take turns in a ring of window bands
+    int band_rows = sched->band_rows;
+    size_t slot = (size_t) (row0 / band_rows % sched->window) * band_rows * width;
+    char *tile_attr = attr + slot + col0, *tile_conv = conv + slot + col0;
+    if (trace) {
+      long n = trace_tile(kernel, poly, frame->row_re + row0, frame->col_im + col0,
+                          row1 - row0, ncols, tile_attr, tile_conv, width);
+      atomic_fetch_add_explicit(&frame->iterated, n, memory_order_relaxed);
     }
-    attr_color_row[12 * img_size - 1] = '\n';
-    con_color_row[12 * img_size - 1] = '\n';
-
-    // write to the file
-    fwrite(attr_color_row, sizeof(char), 12 * img_size, attrfile);
-    fwrite(con_color_row, sizeof(char), 12 * img_size, convfile);
+    if (!trace || verify) {
+      char *out_attr = verify ? check_attr : tile_attr;
+      char *out_conv = verify ? check_conv : tile_conv;
+      size_t stride = verify ? ncols : width;
+      for (int ix = row0; ix < row1; ix++) {
+        // the real part is the same along the row
+        for (int jx = 0; jx < ncols; jx++)
+          re[jx] = frame->row_re[ix];
+        size_t at = (ix - row0) * stride;
+        kernel(poly, re, frame->col_im + col0, ncols, out_attr + at, out_conv + at);
+      }
+    }
+    if (verify) {
+      long nattr = 0, nconv = 0, error = 0;
+      for (int ix = 0; ix < row1 - row0; ix++)
+        for (int jx = 0; jx < ncols; jx++) {
+          size_t at = (size_t) ix * width + jx, check = (size_t) ix * ncols + jx;
+          nattr += tile_attr[at] != check_attr[check];
+          nconv += tile_conv[at] != check_conv[check];
+          error += abs(tile_conv[at] - check_conv[check]);
+        }
+      atomic_fetch_add_explicit(&frame->attr_diffs, nattr, memory_order_relaxed);
+      atomic_fetch_add_explicit(&frame->conv_diffs, nconv, memory_order_relaxed);
+      atomic_fetch_add_explicit(&frame->conv_error, error, memory_order_relaxed);
+    }
+    // the thread completing a band packs it, so that the writer only writes
+    int band = sched_done(sched, tile);
+    if (band < 0)
+      continue;
+    int nrows = sched->rows - band * band_rows;
+    nrows = nrows < band_rows ? nrows : band_rows;
+    if (frame->sym_cols)
+      mirror_cols(frame, attr + slot, conv + slot, nrows);
+    int last = band == sched->nbands - 1;
+    if (image_pack(&frame->attrimg, attr + slot, nrows, last, frame->attrpacks + band) < 0 ||
+        image_pack(&frame->convimg, conv + slot, nrows, last, frame->convpacks + band) < 0)
+      exit(1);
+    if (frame->sym_rows)
+      mirror_rows(frame, band, attr + slot, conv + slot, tmp);
+    sched_publish(sched, band);
   }
+  free(tmp);
 }
 
-// roots for the exponent expression x^degree - 1
-void init_roots() {
-  roots = (double complex**) malloc(sizeof(double complex*) * 9);
-  for (int ix = 0; ix < 9; ix++) {
-    roots[ix] = (double complex*) malloc(sizeof(double complex) * (ix + 1));
+// compute thread
+int comp_thrd(void *args) {
+  int thrd_idx = *(int*) args;
+  if (numa_pin(affinity, thrd_idx) < 0)
+    exit(1);
+  for (int jx = 0; jx < njobs; jx++) {
+    frame_t *frame = frame_enter(jx);
+    comp_frame(frame, thrd_idx);
+    frame_leave(frame);
   }
-  // roots for x - 1
-  roots[0][0] = 1 + 0 * I;
-  // roots for x^2 - 1
-  roots[1][0] = 1 + 0 * I;
-  roots[1][1] = -1 + 0 * I;
-  // roots for x^3 - 1
-  roots[2][0] = 1 + 0 * I;
-  roots[2][1] = -0.5 + 0.86603 * I;
-  roots[2][2] = -0.5 - 0.86606 * I;
-  // roots for x^4 - 1
-  roots[3][0] = 1 + 0 * I;
-  roots[3][1] = 0 + 1 * I;
-  roots[3][2] = -1 + 0 * I;
-  roots[3][3] = 0 - 1 * I;
-  // roots for x^5 - 1
-  roots[4][0] = 1 + 0 * I;
-  roots[4][1] = 0.309017 + 0.951057 * I;
-  roots[4][2] = -0.809017 + 0.587785 * I;
-  roots[4][3] = -0.809017 - 0.587785 * I;
-  roots[4][4] = 0.309017 - 0.951057 * I;
-  // roots for x^6 - 1
-  roots[5][0] = 1 + 0 * I;
-  roots[5][1] = 0.5 + 0.866025 * I;
-  roots[5][2] = -0.5 + 0.866025 * I;
-  roots[5][3] = -1 - 0 * I;
-  roots[5][4] = -0.5 - 0.866025 * I;
-  roots[5][5] = 0.5 - 0.866025 * I;
-  // roots for x^7 - 1
-  roots[6][0] = 1 + 0 * I;
-  roots[6][1] = 0.62349 + 0.781831 * I;
-  roots[6][2] = -0.222521 + 0.974928 * I;
-  roots[6][3] = -0.900969 + 0.433884 * I;
-  roots[6][4] = -0.900969 - 0.433884 * I;
-  roots[6][5] = -0.222521 - 0.974928 * I;
-  roots[6][6] = 0.62349 - 0.781831 * I;
-  // roots for x^8 - 1
-  roots[7][0] = 1 + 0 * I;
-  roots[7][1] = 0.707107 + 0.707107 * I;
-  roots[7][2] = 0 + 1 * I;
-  roots[7][3] = -0.707107 + 0.707107 * I;
-  roots[7][4] = -1 + 0 * I;
-  roots[7][5] = -0.707107 - 0.707107 * I;
-  roots[7][6] = 0 - 1 * I;
-  roots[7][7] = 0.707107 - 0.707107 * I;
-  // roots for x^9 - 1
-  roots[8][0] = 1 + 0 * I;
-  roots[8][1] = 0.766044 + 0.642788 * I;
-  roots[8][2] = 0.173648 + 0.984808 * I;
-  roots[8][3] = -0.5 + 0.866025 * I;
-  roots[8][4] = -0.939693 + 0.34202 * I;
-  roots[8][5] = -0.939693 - 0.34202 * I;
-  roots[8][6] = -0.5 - 0.866025 * I;
-  roots[8][7] = 0.173648 - 0.984808 * I;
-  roots[8][8] = 0.766044 - 0.642788 * I;
+  return 0;
 }
 
-int main(int argc, char *argv[]) {
-  if (argc < 4) {
-    printf("Usage: newton -t[NumberOfThreads] -l[ImageSize] degreeonent\n");
+// writing thread, writer wx writes the bands wx / 2, wx / 2 + step, ... of
+// the attractor image if wx is even, of the convergence image if it is odd
+int writefile(void *args) {
+  int wx = *(int*) args, conv_img = wx % 2;
+  if (numa_pin(affinity, nthrds + wx) < 0)
     exit(1);
+  int step = (nwriters + 1 - conv_img) / 2;
+  for (int jx = 0; jx < njobs; jx++) {
+    frame_t *frame = frame_enter(jx);
+    image_t *img = conv_img ? &frame->convimg : &frame->attrimg;
+    pack_t *packs = conv_img ? frame->convpacks : frame->attrpacks;
+    pack_t *mirror = conv_img ? frame->convmirror : frame->attrmirror;
+    sched_t *sched = &frame->sched;
+    // write band by band, sleeping until the compute threads have packed it
+    for (int band = wx / 2; band < sched->nbands; band += step) {
+      sched_wait(sched, band);
+      if (image_put(img, band * sched->band_rows, packs + band) < 0)
+        exit(1);
+      int first;
+      if (frame->sym_rows && mirror_span(frame, band, &first) > 0 &&
+          image_put(img, first, mirror + band) < 0)
+        exit(1);
+      sched_written(sched, band);
+    }
+    frame_leave(frame);
   }
+  return 0;
+}
 
-  // Parsing command line arguments
-  for (int ix = 1; ix < argc - 1; ix++) {
+// the first roots take the colors of colormap, the others get hues a
+// golden angle apart so that neighbours differ; every color is kept as
+// P3 text ending in a space and as its bytes
+void init_palette() {
+  for (int ix = 0; ix < ATTR_NONE; ix++) {
+    if (ix < 9) {
+      memcpy(palette[ix], colormap[ix], 12);
+      continue;
+    }
+    double h = fmod(ix * 0.618033988749895, 1.0) * 6;
+    double f = h - floor(h), v = 200, lo = v * 0.2;
+    double rgb[6][3] = {{v, lo + (v - lo) * f, lo}, {v - (v - lo) * f, v, lo},
+                        {lo, v, lo + (v - lo) * f}, {lo, v - (v - lo) * f, v},
+                        {lo + (v - lo) * f, lo, v}, {v, lo, v - (v - lo) * f}};
+    double *c = rgb[(int) h % 6];
+    snprintf(palette[ix], 12, "%03d %03d %03d", (int) c[0], (int) c[1], (int) c[2]);
+  }
+  memcpy(palette[ATTR_NONE], colormap[9], 12);
+  for (int ix = 0; ix <= ATTR_NONE; ix++) {
+    palette[ix][11] = ' ';
+    int r, g, b;
+    sscanf(palette[ix], "%d %d %d", &r, &g, &b);
+    palette_rgb[ix][0] = r, palette_rgb[ix][1] = g, palette_rgb[ix][2] = b;
+  }
+  for (int ix = 0; ix < MAX_CONV; ix++) {
+    memcpy(conv_text[ix], colormap_conv[ix], 12);
+    int r, g, b;
+    sscanf(conv_text[ix], "%d %d %d", &r, &g, &b);
+    conv_rgb[ix][0] = r, conv_rgb[ix][1] = g, conv_rgb[ix][2] = b;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // Parsing command line arguments, the ones of the job or the defaults
+  // of the jobs read with -j
+  const char *jobs_path = NULL;
+  job_t job;
+  job_init(&job);
+  int bad = 0;
+  for (int ix = 1; ix < argc; ix++) {
     if (strncmp(argv[ix], "-t", 2) == 0)
       nthrds = atoi(argv[ix]+2);
-    if (strncmp(argv[ix], "-l", 2) == 0)
-      img_size = atoi(argv[ix]+2);
+    else if (strncmp(argv[ix], "-k", 2) == 0)
+      kernel_name = argv[ix]+2;
+    else if (strncmp(argv[ix], "-w", 2) == 0)
+      nwriters = atoi(argv[ix]+2);
+    else if (strncmp(argv[ix], "-m", 2) == 0)
+      mem_mib = atoi(argv[ix]+2);
+    else if (strncmp(argv[ix], "-j", 2) == 0)
+      jobs_path = argv[ix]+2;
+    else if (strcmp(argv[ix], "-b") == 0)
+      trace = 1;
+    else if (strcmp(argv[ix], "-v") == 0)
+      trace = verify = 1;
+    else if (strcmp(argv[ix], "-s") == 0)
+      symmetry = 1;
+    else if (strncmp(argv[ix], "-a", 2) == 0)
+      affinity = numa_mode(argv[ix]+2);
+    else if (strncmp(argv[ix], "-f", 2) == 0) {
+      if (strcmp(argv[ix]+2, "p3") == 0)
+        format = IMAGE_P3;
+      else if (strcmp(argv[ix]+2, "p6") == 0)
+        format = IMAGE_P6;
+      else if (strcmp(argv[ix]+2, "png") == 0)
+        format = IMAGE_PNG;
+      else
+        format = -1;
+    }
+    else
+      bad |= job_arg(&job, argv[ix]) <= 0;
   }
-  degree = atoi(argv[argc-1]);
-
-  // create attractor file and convergence file
-  // and write the required file header
-  FILE *attrfile, *convfile;
-  char filename[26];
-
-  sprintf(filename, "newton_attractors_x%d.ppm", degree);
-  attrfile = fopen(filename, "w");
-  fprintf(attrfile, "P3\n");
-  fprintf(attrfile, "%d %d \n", img_size, img_size);
-  fprintf(attrfile,"255\n");
-
-  sprintf(filename, "newton_convergence_x%d.ppm", degree);
-  convfile = fopen(filename, "w");
-  fprintf(convfile, "P3\n");
-  fprintf(convfile, "%d %d \n", img_size, img_size);
-  fprintf(convfile,"255\n");
-
-  // initialized roots for degreeonent degreeression
-  init_roots();
-
-  // allocate attr and conv array, the size equals img_size * img_size
-  char* attr = (char*) malloc(sizeof(char) * img_size * img_size);
-  char* conv = (char*) malloc(sizeof(char) * img_size * img_size);
-  char* row_done = (char*) calloc(img_size, sizeof(char));
-  // Synchronization of compute and write threads.
-  thrd_t comp_thrds[nthrds];
-  thrd_t write_thrd;
+  int single = jobs_path == NULL;
+  if (nthrds < 1 || bad || format < 0 || affinity < 0 || nwriters < 2 || mem_mib < 0 || (single &&
+      (job.width < 2 || job.height < 2 || (job.degree == 0 && job.coeffs == NULL)))) {
+    printf("Usage: newton -t[NumberOfThreads] -l[ImageSize | WidthxHeight]\n"
+           "              [-c[Re],[Im]] [-z[Zoom]] [-k(avx512|avx2|scalar|dd)]\n"
+           "              [-f(p3|p6|png)] [-w[NumberOfWriters]] [-m[MiB]] [-b | -v] [-s]\n"
+           "              [-a(cores|nodes)]\n"
+           "              [-o[Name]] (degreeonent | -p[Coefficients] | -j[JobFile])\n"
+           "iterates x^degreeonent - 1, or the polynomial with the comma separated\n"
+           "coefficients, highest power first, such as -p1,0,-2,2 or -p1,0,0,1+2i,\n"
+           "from the points around the center, 0 unless -c gives one, the shorter\n"
+           "side spanning 4 / Zoom, the real part along the rows; views too deep\n"
+           "for doubles are iterated in double-double, as -kdd does for any view\n"
+           "the images are ASCII PPM unless -f picks binary PPM or PNG, and are\n"
+           "written by 2 threads unless -w gives more, PNG takes only 1 for each image;\n"
+           "-m streams each image through a ring of bands taking about MiB of memory;\n"
+           "-b iterates the borders of rectangles and fills the ones inside a basin,\n"
+           "-v does so and counts the pixels that differ from iterating all of them;\n"
+           "-s computes x^degreeonent - 1 centered on the real axis only up to the\n"
+           "middle column, centered at 0 with an even degree only the upper half,\n"
+           "and mirrors the rest;\n"
+           "-a pins the threads to cores or NUMA nodes, taking the nodes in turn,\n"
+           "and reports the nodes the bands of every image are on;\n"
+           "-o names the images Name_attractors and Name_convergence;\n"
+           "-j renders the jobs of JobFile, - for the standard input, one a line\n"
+           "with the options -l, -c, -z, -o and the degree or -p, the ones given\n"
+           "here are their defaults; the frames share the threads\n");
+    exit(1);
+  }
+  if (single) {
+    if (job_check(&job, "newton") < 0)
+      exit(1);
+    jobs = &job;
+    njobs = 1;
+  } else if ((njobs = jobs_read(jobs_path, &job, &jobs)) < 0) {
+    exit(1);
+  }
+  init_palette();
+
+  // the frames in flight, enough for every thread to be on a frame of
+  // its own
+  if (format == IMAGE_PNG)
+    nwriters = 2;
+  nslots = nthrds + 1;
+  frames = (frame_t*) calloc(nslots, sizeof(frame_t));
+  if (frames == NULL || mtx_init(&frames_mtx, mtx_plain) != thrd_success ||
+      cnd_init(&frames_cnd) != thrd_success) {
+    fprintf(stderr, "cannot allocate the frames\n");
+    exit(1);
+  }
+  for (int fx = 0; fx < nslots; fx++)
+    frames[fx].job = -1;
 
-  // computation thread arguments array
-  comp_thrd_info_t comp_thrds_info[nthrds];
+  // start the computation and writing threads, PPM bands are written in
+  // place, PNG bands must go in order
+  thrd_t comp_thrds[nthrds], write_thrds[nwriters];
+  int comp_idx[nthrds], write_idx[nwriters];
   int r;
   for (int tx = 0; tx < nthrds; ++tx) {
-    comp_thrds_info[tx].thrd_idx = tx;
-    comp_thrds_info[tx].attr = attr;
-    comp_thrds_info[tx].conv = conv;
-    comp_thrds_info[tx].row_done = row_done;
-    // start computation thread
-    r = thrd_create(comp_thrds+tx, comp_thrd, (void *)(&comp_thrds_info[tx]));
+    comp_idx[tx] = tx;
+    r = thrd_create(comp_thrds+tx, comp_thrd, (void *)(comp_idx+tx));
     if (r != thrd_success) {
       fprintf(stderr, "failed to create thread\n");
       exit(1);
     }
   }
-
-  // writing thread argument
-  write_thrd_info_t write_thrd_info;
-  write_thrd_info.attrfile = attrfile;
-  write_thrd_info.convfile = convfile;
-  write_thrd_info.attr = attr;
-  write_thrd_info.conv = conv;
-  write_thrd_info.row_done = row_done;
-  // start writing thread
-  r = thrd_create(&write_thrd, writefile, (void *)(&write_thrd_info));
-  if (r) {
-    fprintf(stderr, "failed to create thread\n");
-    exit(1);
+  for (int wx = 0; wx < nwriters; wx++) {
+    write_idx[wx] = wx;
+    r = thrd_create(write_thrds+wx, writefile, (void *)(write_idx+wx));
+    if (r != thrd_success) {
+      fprintf(stderr, "failed to create thread\n");
+      exit(1);
+    }
   }
 
   for (int tx = 0; tx < nthrds; tx++) {
     thrd_join(comp_thrds[tx], NULL);
   }
-  thrd_join(write_thrd, NULL);
-
-  // close file
-  fclose(attrfile);
-  fclose(convfile);
+  for (int wx = 0; wx < nwriters; wx++) {
+    thrd_join(write_thrds[wx], NULL);
+  }
 
   // release allocated memory
-  free(attr);
-  free(conv);
-  free(row_done);
-  for (int ix = 0; ix < 9; ix++)
-    free(roots[ix]);
-  free(roots);
+  for (int fx = 0; fx < nslots; fx++) {
+    free(frames[fx].row_re);
+    free(frames[fx].col_im);
+    free(frames[fx].attr);
+    free(frames[fx].conv);
+    free(frames[fx].attrpacks);
+    free(frames[fx].convpacks);
+    free(frames[fx].attrmirror);
+    free(frames[fx].convmirror);
+  }
+  free(frames);
+  mtx_destroy(&frames_mtx);
+  cnd_destroy(&frames_cnd);
+  for (int jx = 0; jx < njobs; jx++)
+    job_free(jobs + jx);
+  if (!single)
+    free(jobs);
 }
-
-
-
@@ -0,0 +1,113 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <threads.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "numa.h"
+
+// nodes looked for in sysfs
+#define NUMA_MAX_NODES 64
+// pages whose node is asked for at most
+#define NUMA_SAMPLE 4096
+
+int numa_mode(const char *s) {
+  return strcmp(s, "cores") == 0 ? NUMA_CORES : strcmp(s, "nodes") == 0 ? NUMA_NODES : -1;
+}
+
+// the cpus of node, a list such as "0-7,16-23", that the process may use
+static int node_cpus(int node, const cpu_set_t *allowed, cpu_set_t *cpus) {
+  char path[64], list[4096];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return -1;
+  int ok = fgets(list, sizeof(list), f) != NULL;
+  fclose(f);
+  CPU_ZERO(cpus);
+  for (char *s = list; ok && *s >= '0' && *s <= '9';) {
+    int lo = strtol(s, &s, 10), hi = *s == '-' ? strtol(s + 1, &s, 10) : lo;
+    for (int cx = lo; cx <= hi && cx < CPU_SETSIZE; ++cx)
+      if (CPU_ISSET(cx, allowed))
+        CPU_SET(cx, cpus);
+    s += *s == ',';
+  }
+  return ok ? 0 : -1;
+}
+
+// the process's own cpus, whatever a thread was pinned to before, by node
+static cpu_set_t allowed;
+static int nnodes;
+static cpu_set_t nodes[NUMA_MAX_NODES];
+static once_flag nodes_once = ONCE_FLAG_INIT;
+
+static void find_nodes(void) {
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    CPU_ZERO(&allowed);
+  for (int nx = 0; nx < NUMA_MAX_NODES; ++nx)
+    if (node_cpus(nx, &allowed, nodes + nnodes) == 0 && CPU_COUNT(nodes + nnodes) > 0)
+      ++nnodes;
+  if (nnodes == 0) {
+    nodes[0] = allowed;
+    nnodes = 1;
+  }
+}
+
+int numa_pin(int mode, int thrd) {
+  if (mode == NUMA_OFF)
+    return 0;
+  call_once(&nodes_once, find_nodes);
+
+  cpu_set_t *node = nodes + thrd % nnodes, set;
+  if (mode == NUMA_NODES) {
+    set = *node;
+  } else {
+    // the (thrd / nnodes)-th cpu of the node, around again if there are
+    // more threads than cpus
+    int nth = thrd / nnodes % CPU_COUNT(node);
+    CPU_ZERO(&set);
+    for (int cx = 0; cx < CPU_SETSIZE; ++cx)
+      if (CPU_ISSET(cx, node) && nth-- == 0) {
+        CPU_SET(cx, &set);
+        break;
+      }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    fprintf(stderr, "cannot pin thread %d\n", thrd);
+    return -1;
+  }
+  return 0;
+}
+
+void numa_report(const char *what, const void *buf, size_t len) {
+  long page = sysconf(_SC_PAGESIZE);
+  uintptr_t first = (uintptr_t) buf / page, last = ((uintptr_t) buf + len + page - 1) / page;
+  size_t npages = last > first ? last - first : 0;
+  size_t n = npages < NUMA_SAMPLE ? npages : NUMA_SAMPLE;
+  if (n == 0)
+    return;
+  void *pages[n];
+  int status[n];
+  for (size_t ix = 0; ix < n; ++ix)
+    pages[ix] = (void*) ((first + ix * npages / n) * page);
+  // without target nodes move_pages only tells where the pages are
+  if (syscall(SYS_move_pages, 0, n, pages, NULL, status, 0) != 0) {
+    fprintf(stderr, "%s: cannot find the nodes of its pages\n", what);
+    return;
+  }
+  size_t count[NUMA_MAX_NODES + 1] = {0};
+  for (size_t ix = 0; ix < n; ++ix)
+    ++count[status[ix] >= 0 && status[ix] < NUMA_MAX_NODES ? status[ix] : NUMA_MAX_NODES];
+  fprintf(stderr, "%s:", what);
+  for (int nx = 0; nx <= NUMA_MAX_NODES; ++nx)
+    if (count[nx]) {
+      if (nx < NUMA_MAX_NODES)
+        fprintf(stderr, " node %d %.1f%%", nx, 100.0 * count[nx] / n);
+      else
+        fprintf(stderr, " not present %.1f%%", 100.0 * count[nx] / n);
+    }
+  fprintf(stderr, "\n");
+}
@@ -0,0 +1,26 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+
+// thread placement on the NUMA nodes, read from sysfs and set with
+// sched_setaffinity, so no libnuma is needed; a machine without the
+// node directories counts as one node holding all cpus
+//
+// the threads are dealt round-robin to the nodes, so that both sockets
+// work from the first two threads on; with NUMA_CORES thread t is pinned
+// to a core of its node, with NUMA_NODES it may run on any core of it
+enum { NUMA_OFF, NUMA_CORES, NUMA_NODES };
+
+// parse "cores" or "nodes", -1 if s is neither
+int numa_mode(const char *s);
+
+// pin the calling thread, the thrd-th, as mode asks
+// returns 0 on success, -1 after printing an error message
+int numa_pin(int mode, int thrd);
+
+// print the share of the pages of [buf, buf + len) on every node, as
+// the kernel reports them to move_pages, for a sample of the pages
+void numa_report(const char *what, const void *buf, size_t len);
+
+#endif
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex.h>
+#include <math.h>
+#include "poly.h"
+
+// cells per axis of the root grid at most
+#define GRID_MAX 256
+
+// p(z) and p'(z) together by Horner's rule
+static void horner(const poly_t *poly, double complex z, double complex *p, double complex *dp) {
+  double complex v = CMPLX(poly->cre[0], poly->cim[0]), d = 0;
+  for (int kx = 1; kx <= poly->degree; ++kx) {
+    d = d * z + v;
+    v = v * z + CMPLX(poly->cre[kx], poly->cim[kx]);
+  }
+  *p = v;
+  *dp = d;
+}
+
+// the argument in [0, 2 pi), roots just below the positive real axis
+// count as on it
+static double angle(double complex z) {
+  double a = carg(z);
+  return a < -1e-9 ? a + 2 * M_PI : a < 0 ? 0 : a;
+}
+
+// all roots at once by the Aberth-Ehrlich method, every approximation
+// moves by its Newton step corrected for the pull of the others
+static int aberth(poly_t *poly) {
+  int n = poly->degree;
+  double complex z[MAX_DEGREE];
+  // start on a circle of the geometric mean radius of the roots, off the axes
+  double lead = cabs(CMPLX(poly->cre[0], poly->cim[0]));
+  double last = cabs(CMPLX(poly->cre[n], poly->cim[n]));
+  double radius = last > 0 ? pow(last / lead, 1.0 / n) : 1;
+  for (int kx = 0; kx < n; ++kx)
+    z[kx] = radius * cexp(I * (2 * M_PI * kx / n + 0.4));
+
+  for (int iter = 0; iter < 1000; ++iter) {
+    double moved = 0;
+    for (int kx = 0; kx < n; ++kx) {
+      double complex p, dp, pull = 0;
+      horner(poly, z[kx], &p, &dp);
+      if (p == 0)
+        continue;
+      for (int jx = 0; jx < n; ++jx)
+        if (jx != kx)
+          pull += 1 / (z[kx] - z[jx]);
+      double complex w = p / dp, step = w / (1 - w * pull);
+      z[kx] -= step;
+      double rel = cabs(step) / (cabs(z[kx]) > 1 ? cabs(z[kx]) : 1);
+      moved = rel > moved ? rel : moved;
+    }
+    if (moved < 1e-15)
+      break;
+  }
+  for (int kx = 0; kx < n; ++kx)
+    if (!isfinite(creal(z[kx])) || !isfinite(cimag(z[kx]))) {
+      fprintf(stderr, "cannot find the roots of the polynomial\n");
+      return -1;
+    }
+
+  // order the roots by their argument in [0, 2 pi) like those of x^d - 1,
+  // then by their modulus
+  for (int kx = 1; kx < n; ++kx)
+    for (int jx = kx; jx > 0; --jx) {
+      double a = angle(z[jx - 1]), b = angle(z[jx]);
+      if (a < b || (a == b && cabs(z[jx - 1]) <= cabs(z[jx])))
+        break;
+      double complex t = z[jx];
+      z[jx] = z[jx - 1];
+      z[jx - 1] = t;
+    }
+  for (int kx = 0; kx < n; ++kx) {
+    poly->re[kx] = creal(z[kx]);
+    poly->im[kx] = cimag(z[kx]);
+  }
+  return 0;
+}
+
+// bin the roots into the cells their NEWTON_EPS disks touch
+static int build_grid(poly_t *poly) {
+  double lo[2] = {INFINITY, INFINITY}, hi[2] = {-INFINITY, -INFINITY};
+  for (int kx = 0; kx < poly->degree; ++kx) {
+    double v[2] = {poly->re[kx], poly->im[kx]};
+    for (int dx = 0; dx < 2; ++dx) {
+      lo[dx] = v[dx] - NEWTON_EPS < lo[dx] ? v[dx] - NEWTON_EPS : lo[dx];
+      hi[dx] = v[dx] + NEWTON_EPS > hi[dx] ? v[dx] + NEWTON_EPS : hi[dx];
+    }
+  }
+  double side = hi[0] - lo[0] > hi[1] - lo[1] ? hi[0] - lo[0] : hi[1] - lo[1];
+  double h = side / GRID_MAX > 3 * NEWTON_EPS ? side / GRID_MAX : 3 * NEWTON_EPS;
+  poly->gx = lo[0];
+  poly->gy = lo[1];
+  poly->ginv = 1 / h;
+  poly->gnx = (int) ((hi[0] - lo[0]) * poly->ginv) + 1;
+  poly->gny = (int) ((hi[1] - lo[1]) * poly->ginv) + 1;
+  size_t ncells = (size_t) poly->gnx * poly->gny;
+  // a disk of radius NEWTON_EPS <= h / 3 touches at most 4 cells, even
+  // with the rounding of its bounds
+  poly->cell = (int32_t*) malloc(sizeof(int32_t) * ncells);
+  poly->cand = (int*) malloc(sizeof(int) * (8 * poly->degree + 1));
+  int *count = (int*) calloc(ncells, sizeof(int));
+  if (poly->cell == NULL || poly->cand == NULL || count == NULL) {
+    fprintf(stderr, "cannot allocate the root grid\n");
+    free(count);
+    return -1;
+  }
+
+  // count the roots of every cell, place the lists, then fill them
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      int at = 0;
+      for (size_t cx = 0; cx < ncells; ++cx) {
+        poly->cell[cx] = count[cx] ? at : -1;
+        at += count[cx] ? count[cx] + 1 : 0;
+        if (count[cx])
+          poly->cand[at - 1] = -1;
+        count[cx] = 0;
+      }
+    }
+    for (int kx = 0; kx < poly->degree; ++kx) {
+      int x0 = (int) ((poly->re[kx] - NEWTON_EPS - poly->gx) * poly->ginv);
+      int x1 = (int) ((poly->re[kx] + NEWTON_EPS - poly->gx) * poly->ginv);
+      int y0 = (int) ((poly->im[kx] - NEWTON_EPS - poly->gy) * poly->ginv);
+      int y1 = (int) ((poly->im[kx] + NEWTON_EPS - poly->gy) * poly->ginv);
+      x0 = x0 > 0 ? x0 : 0;
+      y0 = y0 > 0 ? y0 : 0;
+      x1 = x1 < poly->gnx - 1 ? x1 : poly->gnx - 1;
+      y1 = y1 < poly->gny - 1 ? y1 : poly->gny - 1;
+      for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x) {
+          size_t cx = (size_t) y * poly->gnx + x;
+          if (pass == 1)
+            poly->cand[poly->cell[cx] + count[cx]] = kx;
+          ++count[cx];
+        }
+    }
+  }
+  free(count);
+  return 0;
+}
+
+int poly_unity(poly_t *poly, int degree) {
+  memset(poly, 0, sizeof(*poly));
+  poly->degree = degree;
+  poly->unity = 1;
+  poly->cre[0] = 1;
+  poly->cre[degree] = -1;
+  // root k and root degree - k are computed once so they are conjugate;
+  // for even degrees root degree / 2 - k is the mirror image of root k
+  // about the imaginary axis, which holds root degree / 4 if there is one
+  for (int kx = 0; 2 * kx <= degree; ++kx) {
+    double angle = 2 * M_PI * kx / degree;
+    poly->re[kx] = cos(angle);
+    poly->im[kx] = sin(angle);
+    if (degree % 2 == 0 && 4 * kx == degree)
+      poly->re[kx] = 0;
+    if (degree % 2 == 0 && 4 * kx > degree) {
+      poly->re[kx] = -poly->re[degree / 2 - kx];
+      poly->im[kx] = poly->im[degree / 2 - kx];
+    }
+    if (kx > 0 && 2 * kx < degree) {
+      poly->re[degree - kx] = poly->re[kx];
+      poly->im[degree - kx] = -poly->im[kx];
+    }
+  }
+  // the roots on the real axis are exact
+  poly->re[0] = 1;
+  poly->im[0] = 0;
+  if (degree % 2 == 0) {
+    poly->re[degree / 2] = -1;
+    poly->im[degree / 2] = 0;
+  }
+  return build_grid(poly);
+}
+
+// one coefficient, "2", "-1.5", "3i", "1+2i" or "1-2i"
+static const char *parse_coeff(const char *s, double *re, double *im) {
+  char *end;
+  double v = strtod(s, &end);
+  if (end == s)
+    return NULL;
+  *re = v;
+  *im = 0;
+  if (*end == 'i') {
+    *re = 0;
+    *im = v;
+    return end + 1;
+  }
+  if (*end == '+' || *end == '-') {
+    s = end;
+    v = strtod(s, &end);
+    if (end == s || *end != 'i')
+      return NULL;
+    *im = v;
+    return end + 1;
+  }
+  return end;
+}
+
+int poly_parse(poly_t *poly, const char *s) {
+  memset(poly, 0, sizeof(*poly));
+  double cre[MAX_DEGREE + 2], cim[MAX_DEGREE + 2];
+  int n = 0;
+  for (;;) {
+    if (n == MAX_DEGREE + 1 || (s = parse_coeff(s, cre + n, cim + n)) == NULL ||
+        (*s != ',' && *s != '\0')) {
+      fprintf(stderr, "expected up to %d comma separated coefficients such as 1,0,-2.5,1+2i\n",
+              MAX_DEGREE + 1);
+      return -1;
+    }
+    ++n;
+    if (*s++ == '\0')
+      break;
+  }
+  // leading zeros do not count
+  int first = 0;
+  while (first < n && cre[first] == 0 && cim[first] == 0)
+    ++first;
+  if (n - first < 2) {
+    fprintf(stderr, "the polynomial needs a degree of at least 1\n");
+    return -1;
+  }
+  poly->degree = n - first - 1;
+  memcpy(poly->cre, cre + first, sizeof(double) * (n - first));
+  memcpy(poly->cim, cim + first, sizeof(double) * (n - first));
+
+  // x^d - 1 has its own kernels
+  int unity = poly->cre[0] == 1 && poly->cre[poly->degree] == -1;
+  for (int kx = 0; kx <= poly->degree; ++kx)
+    unity &= poly->cim[kx] == 0 && (kx == 0 || kx == poly->degree || poly->cre[kx] == 0);
+  if (unity)
+    return poly_unity(poly, poly->degree);
+  if (aberth(poly) < 0)
+    return -1;
+  return build_grid(poly);
+}
+
+void poly_free(poly_t *poly) {
+  free(poly->cell);
+  free(poly->cand);
+  poly->cell = NULL;
+  poly->cand = NULL;
+}
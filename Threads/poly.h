@@ -0,0 +1,59 @@
+#ifndef POLY_H
+#define POLY_H
+
+#include <stdint.h>
+
+// a point has converged once it is closer than NEWTON_EPS to a root, it is
+// given up on once one of its parts grows beyond NEWTON_BOUND
+#define NEWTON_EPS 0.001
+#define NEWTON_BOUND 10000000000.0
+
+// the largest degree, root indices must stay below ATTR_NONE
+#define MAX_DEGREE 100
+
+// a polynomial with complex coefficients and its roots
+typedef struct {
+  int degree;
+  int unity;                // the polynomial is x^degree - 1
+  double cre[MAX_DEGREE + 1], cim[MAX_DEGREE + 1];   // highest power first
+  double re[MAX_DEGREE], im[MAX_DEGREE];             // the roots
+
+  // the roots by the cells of a grid over their bounding box: the roots
+  // closer than NEWTON_EPS to cell ix are cand[cell[ix]], cand[cell[ix] + 1],
+  // ... up to a -1, cell[ix] is -1 if there are none
+  double gx, gy;            // lower left corner
+  double ginv;              // cells per unit
+  int gnx, gny;
+  int32_t *cell;
+  int *cand;
+} poly_t;
+
+// x^degree - 1, its roots at angles 2 pi k / degree exactly conjugate
+// returns 0 on success, -1 after printing an error message
+int poly_unity(poly_t *poly, int degree);
+
+// the polynomial with the comma separated coefficients in s, highest power
+// first, each one real such as "-2.5" or complex such as "1+0.5i"; the
+// roots are found with the Aberth-Ehrlich method
+// returns 0 on success, -1 after printing an error message
+int poly_parse(poly_t *poly, const char *s);
+
+void poly_free(poly_t *poly);
+
+// the root within NEWTON_EPS of c, -1 if there is none
+static inline int poly_root_near(const poly_t *poly, double cr, double ci) {
+  double fx = (cr - poly->gx) * poly->ginv, fy = (ci - poly->gy) * poly->ginv;
+  if (!(fx >= 0 && fx < poly->gnx && fy >= 0 && fy < poly->gny))
+    return -1;
+  int32_t at = poly->cell[(int) fy * poly->gnx + (int) fx];
+  if (at < 0)
+    return -1;
+  for (const int *kx = poly->cand + at; *kx >= 0; ++kx) {
+    double dr = cr - poly->re[*kx], di = ci - poly->im[*kx];
+    if (dr * dr + di * di <= NEWTON_EPS * NEWTON_EPS)
+      return *kx;
+  }
+  return -1;
+}
+
+#endif
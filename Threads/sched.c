@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sched.h"
+
+#define EMPTY -1
+#define ABORT -2
+
+static void push(deque_t *dq, long tile) {
+  long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+  atomic_store_explicit(dq->buf + b % dq->cap, tile, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+}
+
+static long pop(deque_t *dq) {
+  long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+  if (t > b) {
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return EMPTY;
+  }
+  long tile = atomic_load_explicit(dq->buf + b % dq->cap, memory_order_relaxed);
+  if (t == b) {
+    // the last tile, race the thieves for it
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed))
+      tile = EMPTY;
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+  }
+  return tile;
+}
+
+static long steal(deque_t *dq) {
+  long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+  if (t >= b)
+    return EMPTY;
+  long tile = atomic_load_explicit(dq->buf + t % dq->cap, memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst,
+                                               memory_order_relaxed))
+    return ABORT;
+  return tile;
+}
+
+int sched_init(sched_t *sched, int nthrds, int rows, int cols, int band_rows, int window,
+               int nwrites) {
+  sched->nthrds = nthrds;
+  sched->rows = rows;
+  sched->cols = cols;
+  sched->band_rows = band_rows;
+  sched->nbands = (rows + band_rows - 1) / band_rows;
+  sched->tiles_per_band = (cols + SCHED_COLS - 1) / SCHED_COLS;
+  long ntiles = (long) sched->nbands * sched->tiles_per_band;
+  long cap = (ntiles + nthrds - 1) / nthrds;
+  sched->deques = (deque_t*) aligned_alloc(64, sizeof(deque_t) * nthrds);
+  sched->left = (atomic_int*) malloc(sizeof(atomic_int) * sched->nbands);
+  sched->band_done = (atomic_int*) malloc(sizeof(atomic_int) * sched->nbands);
+  sched->writes_left = (atomic_int*) malloc(sizeof(atomic_int) * sched->nbands);
+  sched->window = window;
+  sched->nwrites = nwrites;
+  atomic_init(&sched->low, 0);
+  if (sched->deques == NULL || sched->left == NULL || sched->band_done == NULL ||
+      sched->writes_left == NULL) {
+    fprintf(stderr, "cannot allocate the tile scheduler\n");
+    return -1;
+  }
+  for (int bx = 0; bx < sched->nbands; ++bx) {
+    atomic_init(sched->left + bx, sched->tiles_per_band);
+    atomic_init(sched->band_done + bx, 0);
+    atomic_init(sched->writes_left + bx, nwrites);
+  }
+  for (int tx = 0; tx < nthrds; ++tx) {
+    deque_t *dq = sched->deques + tx;
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    dq->cap = cap > 0 ? cap : 1;
+    dq->buf = (atomic_long*) malloc(sizeof(atomic_long) * dq->cap);
+    if (dq->buf == NULL) {
+      fprintf(stderr, "cannot allocate the tile scheduler\n");
+      return -1;
+    }
+    // the owner pops from the bottom, so the first tile goes in last
+    long count = ntiles > tx ? (ntiles - tx + nthrds - 1) / nthrds : 0;
+    for (long kx = count - 1; kx >= 0; --kx)
+      push(dq, tx + kx * nthrds);
+  }
+  if (mtx_init(&sched->mtx, mtx_plain) != thrd_success ||
+      cnd_init(&sched->cnd) != thrd_success || cnd_init(&sched->room) != thrd_success) {
+    fprintf(stderr, "cannot create the scheduler's condition variable\n");
+    return -1;
+  }
+  return 0;
+}
+
+void sched_free(sched_t *sched) {
+  for (int tx = 0; tx < sched->nthrds; ++tx)
+    free(sched->deques[tx].buf);
+  free(sched->deques);
+  free(sched->left);
+  free(sched->band_done);
+  free(sched->writes_left);
+  mtx_destroy(&sched->mtx);
+  cnd_destroy(&sched->cnd);
+  cnd_destroy(&sched->room);
+}
+
+// block until the band of tile is within the window; a thread holds no
+// other tile while it waits, and the tiles left in its deque come after
+// this one, so the first band not written can always be finished
+static long reserve(sched_t *sched, long tile) {
+  int band = tile / sched->tiles_per_band;
+  if (band < atomic_load_explicit(&sched->low, memory_order_acquire) + sched->window)
+    return tile;
+  mtx_lock(&sched->mtx);
+  while (band >= atomic_load_explicit(&sched->low, memory_order_acquire) + sched->window)
+    cnd_wait(&sched->room, &sched->mtx);
+  mtx_unlock(&sched->mtx);
+  return tile;
+}
+
+long sched_next(sched_t *sched, int thrd, unsigned *seed) {
+  long tile = pop(sched->deques + thrd);
+  if (tile != EMPTY)
+    return reserve(sched, tile);
+  // steal from random victims until a full sweep finds every deque empty
+  for (;;) {
+    int aborted = 0;
+    *seed = *seed * 1103515245 + 12345;
+    int first = (*seed >> 16) % sched->nthrds;
+    for (int kx = 0; kx < sched->nthrds; ++kx) {
+      int victim = (first + kx) % sched->nthrds;
+      if (victim == thrd)
+        continue;
+      tile = steal(sched->deques + victim);
+      if (tile >= 0)
+        return reserve(sched, tile);
+      aborted |= tile == ABORT;
+    }
+    if (!aborted)
+      return -1;
+  }
+}
+
+void sched_tile(const sched_t *sched, long tile, int *row0, int *row1, int *col0, int *col1) {
+  int band = tile / sched->tiles_per_band, tx = tile % sched->tiles_per_band;
+  *row0 = band * sched->band_rows;
+  *row1 = *row0 + sched->band_rows < sched->rows ? *row0 + sched->band_rows : sched->rows;
+  *col0 = tx * SCHED_COLS;
+  *col1 = *col0 + SCHED_COLS < sched->cols ? *col0 + SCHED_COLS : sched->cols;
+}
+
+int sched_done(sched_t *sched, long tile) {
+  int band = tile / sched->tiles_per_band;
+  if (atomic_fetch_sub_explicit(sched->left + band, 1, memory_order_acq_rel) != 1)
+    return -1;
+  return band;
+}
+
+void sched_publish(sched_t *sched, int band) {
+  // the lock orders the flag with the writer's check before it sleeps
+  mtx_lock(&sched->mtx);
+  atomic_store_explicit(sched->band_done + band, 1, memory_order_release);
+  cnd_broadcast(&sched->cnd);
+  mtx_unlock(&sched->mtx);
+}
+
+void sched_wait(sched_t *sched, int band) {
+  if (atomic_load_explicit(sched->band_done + band, memory_order_acquire))
+    return;
+  mtx_lock(&sched->mtx);
+  while (!atomic_load_explicit(sched->band_done + band, memory_order_acquire))
+    cnd_wait(&sched->cnd, &sched->mtx);
+  mtx_unlock(&sched->mtx);
+}
+
+void sched_written(sched_t *sched, int band) {
+  if (atomic_fetch_sub_explicit(sched->writes_left + band, 1, memory_order_acq_rel) != 1)
+    return;
+  // bands are written out of order, whoever completes the first one moves
+  // low past all the written bands after it
+  mtx_lock(&sched->mtx);
+  int low = atomic_load_explicit(&sched->low, memory_order_relaxed);
+  while (low < sched->nbands &&
+         atomic_load_explicit(sched->writes_left + low, memory_order_acquire) == 0)
+    ++low;
+  atomic_store_explicit(&sched->low, low, memory_order_release);
+  cnd_broadcast(&sched->room);
+  mtx_unlock(&sched->mtx);
+}
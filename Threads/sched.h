@@ -0,0 +1,70 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdatomic.h>
+#include <threads.h>
+
+// the image is cut into tiles of SCHED_ROWS rows, or as many as asked
+// for, by SCHED_COLS columns; a band is a row of tiles, and the writers
+// take the image band by band; to bound the memory the bands are computed
+// at most a window ahead of the first band not written yet
+#define SCHED_ROWS 8
+#define SCHED_COLS 256
+
+// a work-stealing deque after Chase and Lev: the owner pops from the
+// bottom, other threads steal from the top; all tiles are pushed before
+// the threads start, so it never grows
+typedef struct {
+  _Alignas(64) atomic_long top;
+  _Alignas(64) atomic_long bottom;
+  atomic_long *buf;
+  long cap;
+} deque_t;
+
+typedef struct {
+  int nthrds;
+  int rows, cols;
+  int band_rows, nbands, tiles_per_band;
+  deque_t *deques;        // one per thread
+  atomic_int *left;       // tiles of every band not done yet
+  atomic_int *band_done;
+  int window, nwrites;
+  atomic_int *writes_left; // writes of every band not done yet
+  atomic_int low;         // the first band not written
+  mtx_t mtx;              // the writer sleeps on cnd until a band is done,
+  cnd_t cnd;              // the compute threads on room until low moves
+  cnd_t room;
+} sched_t;
+
+// deal the tiles of band_rows rows of a rows x cols image to nthrds deques, round-robin so
+// that the bands tend to finish in order; a band is written once it has
+// been written nwrites times, and band b is computed only once the bands
+// before b - window + 1 are written
+// returns 0 on success, -1 after printing an error message
+int sched_init(sched_t *sched, int nthrds, int rows, int cols, int band_rows, int window,
+               int nwrites);
+void sched_free(sched_t *sched);
+
+// the next tile for thread thrd, its own or a stolen one, -1 if all tiles
+// have been handed out; seed is the thread's state for picking victims;
+// blocks until the tile's band is within the window
+long sched_next(sched_t *sched, int thrd, unsigned *seed);
+
+// the rows [row0, row1) and columns [col0, col1) of tile
+void sched_tile(const sched_t *sched, long tile, int *row0, int *row1, int *col0, int *col1);
+
+// mark the tile computed, returns its band if it was the band's last
+// tile, -1 otherwise
+int sched_done(sched_t *sched, long tile);
+
+// hand a complete band to the writer and wake it
+void sched_publish(sched_t *sched, int band);
+
+// block until band has been published
+void sched_wait(sched_t *sched, int band);
+
+// count one write of band, waking the compute threads once the first
+// band not written moves
+void sched_written(sched_t *sched, int band);
+
+#endif
@@ -0,0 +1,104 @@
+#include "trace.h"
+
+typedef struct {
+  kernel_fn kernel;
+  const poly_t *poly;
+  const double *re, *im;
+  char *attr, *conv;
+  size_t stride;
+  double *line_re, *line_im;  // a line of points and its results
+  char *line_attr, *line_conv;
+  long iterated;
+} trace_t;
+
+// iterate the n pixels from (r, c) on, each one (dr, dc) after the other
+static void line(trace_t *t, int r, int c, int dr, int dc, int n) {
+  if (n <= 0)
+    return;
+  t->iterated += n;
+  if (dr == 0) {
+    // a row is contiguous, its results go in place
+    for (int kx = 0; kx < n; ++kx)
+      t->line_re[kx] = t->re[r];
+    size_t at = (size_t) r * t->stride + c;
+    t->kernel(t->poly, t->line_re, t->im + c, n, t->attr + at, t->conv + at);
+    return;
+  }
+  for (int kx = 0; kx < n; ++kx) {
+    t->line_re[kx] = t->re[r + kx * dr];
+    t->line_im[kx] = t->im[c + kx * dc];
+  }
+  t->kernel(t->poly, t->line_re, t->line_im, n, t->line_attr, t->line_conv);
+  for (int kx = 0; kx < n; ++kx) {
+    size_t at = (size_t) (r + kx * dr) * t->stride + c + kx * dc;
+    t->attr[at] = t->line_attr[kx];
+    t->conv[at] = t->line_conv[kx];
+  }
+}
+
+// fill the inside of the rectangle with rows r0..r1 and columns c0..c1,
+// whose border is done
+static void rect(trace_t *t, int r0, int r1, int c0, int c1) {
+  int h = r1 - r0 - 1, w = c1 - c0 - 1;
+  if (h <= 0 || w <= 0)
+    return;
+  char *attr = t->attr, *conv = t->conv;
+  size_t s = t->stride;
+
+  // the whole border converges to one root
+  char root = attr[r0 * s + c0];
+  int same = root != ATTR_NONE;
+  for (int cx = c0; same && cx <= c1; ++cx)
+    same = attr[r0 * s + cx] == root && attr[r1 * s + cx] == root;
+  for (int rx = r0 + 1; same && rx < r1; ++rx)
+    same = attr[rx * s + c0] == root && attr[rx * s + c1] == root;
+  if (same) {
+    // the mean of interpolating the border across the rows and the columns
+    for (int rx = r0 + 1; rx < r1; ++rx) {
+      double fr = (double) (rx - r0) / (r1 - r0);
+      double left = conv[rx * s + c0], right = conv[rx * s + c1];
+      for (int cx = c0 + 1; cx < c1; ++cx) {
+        double fc = (double) (cx - c0) / (c1 - c0);
+        double down = conv[r0 * s + cx] * (1 - fr) + conv[r1 * s + cx] * fr;
+        double across = left * (1 - fc) + right * fc;
+        attr[rx * s + cx] = root;
+        conv[rx * s + cx] = (char) ((down + across) / 2 + 0.5);
+      }
+    }
+    return;
+  }
+  if (h * w < TRACE_MIN) {
+    for (int rx = r0 + 1; rx < r1; ++rx)
+      line(t, rx, c0 + 1, 0, 1, w);
+    return;
+  }
+  if (w >= h) {
+    int cm = (c0 + c1) / 2;
+    line(t, r0 + 1, cm, 1, 0, h);
+    rect(t, r0, r1, c0, cm);
+    rect(t, r0, r1, cm, c1);
+  } else {
+    int rm = (r0 + r1) / 2;
+    line(t, rm, c0 + 1, 0, 1, w);
+    rect(t, r0, rm, c0, c1);
+    rect(t, rm, r1, c0, c1);
+  }
+}
+
+long trace_tile(kernel_fn kernel, const poly_t *poly, const double *re, const double *im,
+                int h, int w, char *attr, char *conv, size_t stride) {
+  int n = h > w ? h : w;
+  double line_re[n], line_im[n];
+  char line_attr[n], line_conv[n];
+  trace_t t = {kernel, poly, re, im, attr, conv, stride,
+               line_re, line_im, line_attr, line_conv, 0};
+  // the border: the first and last rows, then the columns between them
+  line(&t, 0, 0, 0, 1, w);
+  if (h > 1)
+    line(&t, h - 1, 0, 0, 1, w);
+  line(&t, 1, 0, 1, 0, h - 2);
+  if (w > 1)
+    line(&t, 1, w - 1, 1, 0, h - 2);
+  rect(&t, 0, h - 1, 0, w - 1);
+  return t.iterated;
+}
@@ -0,0 +1,23 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include "kernel.h"
+
+// tiles are this tall when tracing, so that there are large squares to fill
+#define TRACE_ROWS 64
+
+// rectangles with fewer pixels inside are iterated in full
+#define TRACE_MIN 16
+
+// render the h x w tile whose pixel (r, c) is re[r] + im[c] i and goes to
+// attr[r * stride + c] and conv[r * stride + c] after Mariani and Silver:
+// the border of the tile is iterated, and a rectangle whose border
+// converges to one root is filled with it, the iterations interpolated
+// from the border; other rectangles are split in two across their longer
+// side, the new line iterated, until they are small
+// returns the number of pixels iterated
+long trace_tile(kernel_fn kernel, const poly_t *poly, const double *re, const double *im,
+                int h, int w, char *attr, char *conv, size_t stride);
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bins.h"
+
+// floor(sqrt(d2)) computed exactly
+static uint32_t isqrt(uint64_t d2) {
+  uint64_t r = (uint64_t) sqrt((double) d2);
+  while (r * r > d2)
+    --r;
+  while ((r + 1) * (r + 1) <= d2)
+    ++r;
+  return r;
+}
+
+// smallest integer whose float conversion is at least the float with bits u
+static uint32_t bucket_start(uint32_t u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  uint64_t lo = 1, hi = (uint64_t) ceil(f);
+  while (lo < hi) {
+    uint64_t mid = (lo + hi) / 2;
+    if ((float) mid >= f)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+// the bin of d2, pairs beyond the range go to the last bin
+static uint64_t bin_of(const bins_t *bins, uint64_t d2) {
+  uint64_t b = (bins->squared ? d2 : isqrt(d2)) / bins->width;
+  return b < bins->nbins - 1 ? b : bins->nbins - 1;
+}
+
+int bins_init(bins_t *bins, uint32_t width, int squared, uint64_t range,
+              uint32_t max_d2, int16_t box) {
+  bins->width = width;
+  bins->squared = squared;
+  bins->box = box;
+  bins->nbins = SIZE_MAX;
+  uint64_t reach = bin_of(bins, max_d2) + 1;
+  uint64_t nrange = range ? (range + width - 1) / width : reach;
+  bins->nbins = (nrange < reach ? nrange : reach) + 1;
+
+  bins->thr = (uint32_t*) malloc(sizeof(uint32_t) * (bins->nbins + 1));
+  for (size_t bx = 0; bx < bins->nbins; ++bx) {
+    uint64_t t = squared ? (uint64_t) bx * width : (uint64_t) bx * width * bx * width;
+    bins->thr[bx] = t < INT32_MAX ? t : INT32_MAX;
+  }
+  // sentinel above every squared distance, also as a signed int
+  bins->thr[bins->nbins] = INT32_MAX;
+
+  // use the coarsest buckets that never span more than one bin boundary
+  float one = 1.f;
+  uint32_t one_bits;
+  memcpy(&one_bits, &one, sizeof(one_bits));
+  for (int mbits = 4; mbits <= 23; ++mbits) {
+    bins->shift = 23 - mbits;
+    bins->base = one_bits >> bins->shift;
+    size_t nbuckets = bins_bucket(bins, max_d2) + 1;
+    bins->lut = (uint32_t*) malloc(sizeof(uint32_t) * nbuckets);
+
+    int ok = 1;
+    uint32_t start = 1;
+    for (size_t kx = 0; kx < nbuckets && ok; ++kx) {
+      uint64_t next = kx + 1 < nbuckets ?
+        bucket_start((kx + 1 + bins->base) << bins->shift) : (uint64_t) max_d2 + 1;
+      // d2 = 0 shares the bucket of 1 and always lands in bin 0
+      bins->lut[kx] = bin_of(bins, kx ? start : 0);
+      ok = bin_of(bins, next - 1) <= bins->lut[kx] + 1;
+      start = next;
+    }
+    if (ok)
+      return 0;
+    free(bins->lut);
+  }
+  fprintf(stderr, "bin width %u too small for squared distances up to %u\n",
+          width, max_d2);
+  free(bins->thr);
+  return -1;
+}
+
+void bins_free(bins_t *bins) {
+  free(bins->thr);
+  free(bins->lut);
+}
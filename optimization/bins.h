@@ -0,0 +1,48 @@
+#ifndef BINS_H
+#define BINS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// maps exact squared distances to histogram bins without a square root
+//
+// a squared distance d2 is converted to float and the exponent plus the
+// top mantissa bits of its representation select a bucket; lut holds the
+// lowest bin reachable from every bucket and a single comparison against
+// the threshold table thr moves to the next bin if needed
+//
+// bins are either distances or squared distances, so both metrics cost
+// the same in the kernels; the last bin counts the pairs beyond the range
+typedef struct {
+  size_t nbins;     // bins in the range plus one for the pairs beyond it
+  uint32_t width;   // bin width in thousandths, millionths if squared
+  int squared;      // bins of squared distances
+  int16_t box;      // side of the periodic box in thousandths, 0 if open
+  uint32_t *thr;    // thr[b] is the smallest squared distance in bin b
+  uint32_t *lut;    // first bin of every float bucket
+  int shift;        // float bits dropped to form the bucket index
+  uint32_t base;    // bucket index of 1.0f
+} bins_t;
+
+// build the tables for bins of the given width covering [0, range), in
+// the units of width, for squared distances up to max_d2; a range of 0
+// covers all distances up to max_d2
+// returns 0 on success, -1 after printing an error message
+int bins_init(bins_t *bins, uint32_t width, int squared, uint64_t range,
+              uint32_t max_d2, int16_t box);
+void bins_free(bins_t *bins);
+
+static inline uint32_t bins_bucket(const bins_t *bins, uint32_t d2) {
+  float f = (float) (d2 ? d2 : 1);
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return (u >> bins->shift) - bins->base;
+}
+
+static inline uint32_t bins_lookup(const bins_t *bins, uint32_t d2) {
+  uint32_t b = bins->lut[bins_bucket(bins, d2)];
+  return b + (d2 >= bins->thr[b + 1]);
+}
+
+#endif
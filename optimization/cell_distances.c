@@ -3,103 +3,500 @@
 #include <math.h>
 #include "omp.h"
 #include <string.h>
+#include <unistd.h>
+#include "parse.h"
+#include "cells.h"
+#include "bins.h"
+#include "kernel.h"
+#include "tiles.h"
+#include "grid.h"
+#include "sample.h"
+#include "numa.h"
+#include "stream.h"
+#include "hist.h"
+#include "histio.h"
+#include "output.h"
 
-char* filename = "cells";
 int num_threads;
 
-int main(int argc, char const *argv[])
-{
-  if(argc != 2)
-   {
-    printf("\n!!! Argument count not equal to 2. \n");
+// one input file, either decoded into memory or streamed
+typedef struct {
+  const char *path;
+  stream_t st;
+  cells_t cells;
+  size_t n;
+  int16_t lo[3], hi[3];
+} input_t;
+
+// read and decode the file, coordinates are kept as int16 thousandths
+// in separate x, y, z arrays, or index its lines [first, last) for
+// streaming with a budget
+static int input_open(input_t *in, const char *path, size_t budget, size_t tile,
+                      size_t first, size_t last) {
+  in->path = path;
+  if (budget > 0) {
+    if (stream_open(&in->st, path, budget, tile, first, last) < 0)
+      return -1;
+    in->n = in->st.n;
+    memcpy(in->lo, in->st.lo, sizeof(in->lo));
+    memcpy(in->hi, in->st.hi, sizeof(in->hi));
+    return 0;
+  }
+  coords_t coords;
+  if (parse_file(path, num_threads, &coords) < 0)
+    return -1;
+  int ret = cells_from_coords(&in->cells, &coords, path);
+  free(coords.xyz);
+  if (ret < 0)
+    return -1;
+  in->n = in->cells.n;
+  cells_bounds(&in->cells, in->lo, in->hi);
+  return 0;
+}
+
+// number of decimals needed to print multiples of value, scaled by 10^digits
+static int decimals(uint64_t value, int digits) {
+  while (digits > 0 && value % 10 == 0) {
+    value /= 10;
+    --digits;
+  }
+  return digits;
+}
 
+// add up the shards of a histogram and print it like a run of all pairs
+static int merge(int argc, char const *argv[]) {
+  const char *format = "text";
+  const char *paths[argc];
+  int npaths = 0;
+  num_threads = 1;
+  for (int ix = 1; ix < argc; ix++) {
+    if (strncmp(argv[ix], "-t", 2) == 0)
+      num_threads = atoi(argv[ix]+2);
+    else if (strncmp(argv[ix], "-o", 2) == 0)
+      format = argv[ix]+2;
+    else if (argv[ix][0] != '-')
+      paths[npaths++] = argv[ix];
+    else
+      num_threads = 0;
+  }
+  if (num_threads < 1 || npaths == 0) {
+    printf("Usage: cell_distances merge [-t[NumberOfThreads]] [-o(text|csv|binary)] shard...\n"
+           "adds up the histograms written by the shards -n0/K to -nK-1/K of a run\n");
+    exit(1);
+  }
+  int binary = strcmp(format, "binary") == 0, csv = strcmp(format, "csv") == 0;
+  if (!binary && !csv && strcmp(format, "text") != 0) {
+    fprintf(stderr, "unknown output format %s\n", format);
     exit(1);
-   }
-  else
-    {
-     num_threads = atoi(argv[1]+2);
+  }
+  omp_set_num_threads(num_threads);
+
+  histio_t hdr;
+  uint64_t *counts;
+  if (histio_merge(paths, npaths, &hdr, &counts) < 0 ||
+      hist_check(counts, hdr.nbins, hdr.pairs, hdr.pairs) < 0)
+    exit(1);
+  if (counts[hdr.nbins - 1] > 0)
+    fprintf(stderr, "%lu pairs beyond the maximum distance\n",
+            (unsigned long) counts[hdr.nbins - 1]);
+  int digits = hdr.flags & HISTIO_SQUARED ? 6 : 3;
+  int prec = decimals(hdr.width, digits) > 2 ? decimals(hdr.width, digits) : 2;
+  if (binary) {
+    if (histio_put(stdout, &hdr, counts) < 0) {
+      fprintf(stderr, "cannot write the histogram\n");
+      exit(1);
     }
+  } else if (output_text(STDOUT_FILENO, counts, hdr.nbins, hdr.width, digits, prec, csv) < 0) {
+    exit(1);
+  }
+  free(counts);
+  return 0;
+}
 
-  // read the files
-  FILE* fp = fopen(filename, "r");
-  int count = 0;
-  char c = 0;
-  
-  // get the characters and store in char c, increase the count if the character is new line
-  while(!feof(fp))
-  {
-    c = fgetc(fp);
-    if(c == '\n')
-     {
-       ++count;
-     }
+int main(int argc, char const *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "merge") == 0)
+    return merge(argc - 1, argv + 1);
+  const char *kernel_name = NULL;
+  const char *width_arg = "0.01", *range_arg = "auto", *box_arg = NULL;
+  const char *metric = "euclid", *format = "text";
+  const char *paths[2] = {"cells", NULL}, *state_path = NULL;
+  int npaths = 0;
+  size_t budget_mb = 0;
+  int cutoff = 0;
+  double sample_pairs = 0, relerr = 0;
+  uint64_t seed = 1;
+  uint64_t shard = 0, nshards = 0;
+  int affinity = NUMA_OFF;
+  num_threads = 0;
+  for (int ix = 1; ix < argc; ix++) {
+    if (strncmp(argv[ix], "-t", 2) == 0)
+      num_threads = atoi(argv[ix]+2);
+    else if (strncmp(argv[ix], "-k", 2) == 0)
+      kernel_name = argv[ix]+2;
+    else if (strncmp(argv[ix], "-m", 2) == 0)
+      budget_mb = atol(argv[ix]+2);
+    else if (strncmp(argv[ix], "-w", 2) == 0)
+      width_arg = argv[ix]+2;
+    else if (strncmp(argv[ix], "-r", 2) == 0)
+      range_arg = argv[ix]+2;
+    else if (strncmp(argv[ix], "-c", 2) == 0) {
+      range_arg = argv[ix]+2;
+      cutoff = 1;
+    }
+    else if (strncmp(argv[ix], "-d", 2) == 0)
+      metric = argv[ix]+2;
+    else if (strncmp(argv[ix], "-L", 2) == 0)
+      box_arg = argv[ix]+2;
+    else if (strncmp(argv[ix], "-s", 2) == 0 && argv[ix][2])
+      state_path = argv[ix]+2;
+    else if (strncmp(argv[ix], "-o", 2) == 0)
+      format = argv[ix]+2;
+    else if (strncmp(argv[ix], "-p", 2) == 0)
+      sample_pairs = atof(argv[ix]+2);
+    else if (strncmp(argv[ix], "-e", 2) == 0)
+      relerr = atof(argv[ix]+2);
+    else if (strncmp(argv[ix], "-x", 2) == 0)
+      seed = strtoull(argv[ix]+2, NULL, 10);
+    else if (strncmp(argv[ix], "-a", 2) == 0) {
+      affinity = numa_mode(argv[ix]+2);
+      if (affinity < 0)
+        num_threads = 0;
+    }
+    else if (strncmp(argv[ix], "-n", 2) == 0) {
+      char *end;
+      shard = strtoull(argv[ix]+2, &end, 10);
+      nshards = *end == '/' ? strtoull(end + 1, &end, 10) : 0;
+      if (*end || shard >= nshards)
+        num_threads = 0;
+    }
+    else if (argv[ix][0] != '-' && npaths < 2)
+      paths[npaths++] = argv[ix];
+    else
+      num_threads = 0;
+  }
+  if (num_threads < 1) {
+    printf("Usage: cell_distances -t[NumberOfThreads] [-w[BinWidth]]\n"
+           "                      [-r[MaxDistance|auto] | -c[Cutoff]]\n"
+           "                      [-d(euclid|sq|periodic|periodic-sq)] [-L[BoxSide]]\n"
+           "                      [-m[MemoryBudgetMiB]] [-k(avx512|avx2|scalar)] [-s[StateFile]]\n"
+           "                      [-o(text|csv|binary)] [-p[Pairs]] [-e[RelError]] [-x[Seed]]\n"
+           "                      [-n[Shard]/[NumberOfShards]] [-a(cores|nodes)] [file [file]]\n"
+           "       cell_distances merge [-t[NumberOfThreads]] [-o(text|csv|binary)] shard...\n"
+           "the distances within one file (default cells), or between two files;\n"
+           "with a state file only the pairs of points appended since the last run\n"
+           "are counted; with a cutoff the distances end there like with -r, but only\n"
+           "the pairs in neighbouring cells of a grid that wide are compared;\n"
+           "-p and -e estimate the counts from a random sample of at most Pairs\n"
+           "pairs, or of enough for RelError in the bins with 1%% of the pairs,\n"
+           "with the half width of their 95%% confidence interval after them;\n"
+           "-n counts only one of NumberOfShards equal parts of the pairs and writes\n"
+           "them as a binary histogram, merge adds the parts up;\n"
+           "-a pins the threads to cores or NUMA nodes, taking the nodes in turn,\n"
+           "and reports the nodes the points are on\n");
+    exit(1);
+  }
+  int binary = strcmp(format, "binary") == 0, csv = strcmp(format, "csv") == 0;
+  if (!binary && !csv && strcmp(format, "text") != 0) {
+    fprintf(stderr, "unknown output format %s\n", format);
+    exit(1);
+  }
+  if (nshards > 0 && (budget_mb > 0 || state_path || cutoff || sample_pairs > 0 || relerr > 0)) {
+    fprintf(stderr, "a shard needs the input files in memory, without a state file,"
+            " a cutoff or sampling\n");
+    exit(1);
+  }
+  // a shard is only a part of the histogram, kept in binary for merge
+  binary |= nshards > 0;
+  if (state_path && npaths > 1) {
+    fprintf(stderr, "a state file needs a single input file\n");
+    exit(1);
+  }
+  int sampled = sample_pairs > 0 || relerr > 0;
+  if (sample_pairs < 0 || relerr < 0 || relerr >= 1) {
+    fprintf(stderr, "the sampled pairs must be positive and the relative error in (0, 1)\n");
+    exit(1);
+  }
+  if (sampled && (budget_mb > 0 || state_path || cutoff || binary)) {
+    fprintf(stderr, "sampling needs the input files in memory and text or csv output\n");
+    exit(1);
+  }
+  if (cutoff && (npaths > 1 || state_path || budget_mb > 0)) {
+    fprintf(stderr, "a cutoff needs a single input file held in memory\n");
+    exit(1);
   }
-  fclose(fp);
 
+  // squared distances bin in units^2, so their widths take 6 decimals
+  int periodic = strncmp(metric, "periodic", 8) == 0;
+  int squared = strcmp(metric, periodic ? "periodic-sq" : "sq") == 0;
+  if (!squared && strcmp(metric, periodic ? "periodic" : "euclid") != 0) {
+    fprintf(stderr, "unknown metric %s\n", metric);
+    exit(1);
+  }
+  int digits = squared ? 6 : 3;
+  uint64_t width, range = 0, box = 0;
+  if (parse_decimal(width_arg, digits, &width) < 0 || width == 0 || width > UINT32_MAX) {
+    fprintf(stderr, "bin width must be a positive multiple of 0.%0*d\n", digits, 1);
+    exit(1);
+  }
+  if (strcmp(range_arg, "auto") != 0 && parse_decimal(range_arg, digits, &range) < 0) {
+    fprintf(stderr, "maximum distance must be a number or auto\n");
+    exit(1);
+  }
+  if (cutoff && (range == 0 || periodic)) {
+    fprintf(stderr, "a cutoff must be a positive distance with open boundaries\n");
+    exit(1);
+  }
+  if (periodic && (box_arg == NULL || parse_decimal(box_arg, 3, &box) < 0 ||
+                   box == 0 || box > 2 * COORD_LIMIT)) {
+    fprintf(stderr, "periodic distances need a box side -L up to %d.%03d\n",
+            2 * COORD_LIMIT / 1000, 2 * COORD_LIMIT % 1000);
+    exit(1);
+  }
 
+  const char *selected;
+  kernel_fn kernel = kernel_select(kernel_name, periodic, &selected);
+  if (kernel == NULL) {
+    fprintf(stderr, "kernel %s not available\n", kernel_name);
+    exit(1);
+  }
 
-  int lines = count + 1;
-  float coord[lines][3];
+  omp_set_num_threads(num_threads);
+  // the threads are pinned once, OpenMP keeps them for the later regions
+  if (affinity != NUMA_OFF) {
+    int failed = 0;
+#pragma omp parallel reduction(|: failed)
+    failed = numa_pin(affinity, omp_get_thread_num()) < 0;
+    if (failed)
+      exit(1);
+  }
+  size_t tile = tiles_default_size();
 
-//get the x,y,z from file
-  FILE* fpr = fopen(filename, "r");
+  // a saved histogram made with the same options covers its first npoints
+  histio_t state = {(squared ? HISTIO_SQUARED : 0) | (periodic ? HISTIO_PERIODIC : 0),
+                    width, range, box, 0, 0, 0};
+  histio_t saved;
+  uint64_t *saved_counts = NULL;
+  size_t old = 0;
+  if (state_path && access(state_path, F_OK) == 0) {
+    if (histio_read(state_path, &saved, &saved_counts) < 0)
+      exit(1);
+    if (histio_same_bins(&saved, &state))
+      old = saved.npoints;
+    else
+      fprintf(stderr, "%s has other bins, counting all pairs\n", state_path);
+  }
 
-  float xt;
-  float yt;
-  float zt;
+  // streamed, the old and the new points are opened as two ranges of the
+  // file, in memory they are two parts of the same arrays
+  input_t in[2];
+  int ninputs = npaths > 1 ? 2 : 1, nopen = ninputs;
+  size_t budget = budget_mb << 20;
+  if (old > 0 && budget > 0) {
+    if (input_open(in, paths[0], budget / 2, tile, 0, old) < 0)
+      exit(1);
+    if (in[0].n == old && in[0].st.hash == saved.hash) {
+      if (input_open(in + 1, paths[0], budget / 2, tile, old, SIZE_MAX) < 0)
+        exit(1);
+      state.hash = in[1].st.hash;
+      nopen = 2;
+    } else {
+      stream_close(&in[0].st);
+      old = 0;
+    }
+  }
+  if (nopen == ninputs)
+    for (int ix = 0; ix < ninputs; ++ix)
+      if (input_open(in + ix, paths[ix], budget, tile, 0, SIZE_MAX) < 0)
+        exit(1);
+  size_t npoints = nopen > ninputs ? in[0].n + in[1].n : in[0].n;
+  if (old > 0 && budget == 0) {
+    if (in[0].n < old || cells_hash(&in[0].cells, 0, old, CELLS_HASH_SEED) != saved.hash)
+      old = 0;
+    else
+      state.hash = cells_hash(&in[0].cells, old, npoints, saved.hash);
+  }
+  if ((state_path || binary) && ninputs == 1 && old == 0) {
+    state.hash = budget > 0 ? in[0].st.hash : cells_hash(&in[0].cells, 0, npoints, CELLS_HASH_SEED);
+    if (saved_counts && histio_same_bins(&saved, &state))
+      fprintf(stderr, "%s does not start with the points of %s, counting all pairs\n",
+              paths[0], state_path);
+  }
 
-  for(size_t ix = 0; ix < lines ; ++ix)
-    {
-     fscanf(fp, "%f %f %f", &xt, &yt, &zt);
-     coord[ix][0] = (xt);
-     coord[ix][1] = (yt);
-     coord[ix][2] = (zt);
+  // the largest squared distance of the data, which bounds the tables
+  uint32_t max_d2 = 0;
+  for (int dx = 0; dx < 3; ++dx) {
+    int lo = in[0].lo[dx], hi = in[0].hi[dx];
+    if (nopen > 1) {
+      lo = in[1].lo[dx] < lo ? in[1].lo[dx] : lo;
+      hi = in[1].hi[dx] > hi ? in[1].hi[dx] : hi;
+    }
+    if (lo > hi)
+      continue;
+    uint32_t extent = hi - lo;
+    if (periodic && extent > box) {
+      fprintf(stderr, "points span %u.%03u on axis %d, more than the box\n",
+              extent / 1000, extent % 1000, dx);
+      exit(1);
     }
-   fclose(fpr);
+    if (periodic)
+      extent = box / 2;
+    max_d2 += extent * extent;
+  }
 
-  
-  int MAX_DIST = 3465;//as the coordinates are between -10 and 10, the maximum distance between two points will be 20*sqrt(3) = 34.64, and there will be 3465 possible distancs to be counted
-  unsigned long dis_count[3465] = {0};
+  // squared distances are exact integers, a threshold table maps them to
+  // bins without a square root
+  bins_t bins;
+  if (bins_init(&bins, width, squared, range, max_d2, box) < 0)
+    exit(1);
+  size_t MAX_DIST = bins.nbins;
+  uint64_t *dis_count = (uint64_t*) calloc(MAX_DIST, sizeof(uint64_t));
+  uint64_t pairs, expected;
+  sample_t sample;
 
-  size_t cell_1;
-  size_t cell_2;
+  if (sampled) {
+    // a pilot sample sizes the one for a relative error, the pairs asked
+    // for bound it; the sample counts are scaled to estimates at the end
+    uint64_t size = sample_pairs > 0 && sample_pairs < 0x1p64 ? sample_pairs : UINT64_MAX;
+    const cells_t *other = &in[ninputs - 1].cells;
+    for (int stream = relerr > 0; stream >= 0; --stream) {
+      if (ninputs > 1)
+        sample_cross(&sample, in[0].n, in[1].n, stream ? SAMPLE_PILOT : size, seed, stream);
+      else
+        sample_self(&sample, in[0].n, stream ? SAMPLE_PILOT : size, seed, stream);
+      memset(dis_count, 0, sizeof(uint64_t) * MAX_DIST);
+      if (sample_run(&sample, &in[0].cells, other, &bins, dis_count) < 0)
+        exit(1);
+      if (stream) {
+        uint64_t need = sample_needed(&sample, dis_count, MAX_DIST, relerr);
+        size = need < size ? need : size;
+      }
+    }
+    pairs = expected = sample.size;
+  } else if (ninputs > 1) {
+    // all pairs between the two sets
+    expected = (uint64_t) in[0].n * in[1].n;
+    if (budget_mb > 0) {
+      if (stream_count_cross(&in[0].st, &in[1].st, &bins, kernel, dis_count, &pairs) < 0)
+        exit(1);
+    } else {
+      tiles_t tiles;
+      tiles_cross(&tiles, in[0].n, in[1].n, tile);
+      state.pairs = expected;
+      if (nshards > 0)
+        expected = tiles_shard(&tiles, shard, nshards);
+      pairs = tiles_run(&tiles, &in[0].cells, &in[1].cells, &bins, kernel, dis_count);
+    }
+  } else if (old > 0) {
+    // only the pairs with a new point, new x old and new x new
+    size_t fresh = npoints - old;
+    expected = (uint64_t) fresh * old + (uint64_t) fresh * (fresh - (fresh > 0)) / 2;
+    uint64_t self;
+    if (budget > 0) {
+      if (stream_count_cross(&in[0].st, &in[1].st, &bins, kernel, dis_count, &pairs) < 0 ||
+          stream_count(&in[1].st, &bins, kernel, dis_count, &self) < 0)
+        exit(1);
+    } else {
+      cells_t head = in[0].cells, tail = in[0].cells;
+      head.n = old;
+      tail.n = fresh;
+      tail.x += old;
+      tail.y += old;
+      tail.z += old;
+      tiles_t tiles;
+      tiles_cross(&tiles, old, fresh, tile);
+      pairs = tiles_run(&tiles, &head, &tail, &bins, kernel, dis_count);
+      tiles_self(&tiles, fresh, tile);
+      self = tiles_run(&tiles, &tail, &tail, &bins, kernel, dis_count);
+    }
+    pairs += self;
 
-  omp_set_num_threads(num_threads);
-#pragma omp parallel shared(coord, lines)
-  {
-    unsigned int local_distCounter[3465] = {0};
-#pragma omp for private(cell_1, cell_2) schedule (dynamic, 30)
-    for(cell_1 = 0; cell_1 < (lines - 1); ++cell_1)
-      {
-       float x1 = coord[cell_1][0];
-       float y1 = coord[cell_1][1];
-       float z1 = coord[cell_1][2];
-
-      // compute the distances
-      for(cell_2 = (cell_1 + 1); cell_2 < lines; ++cell_2)
-	{
- 	 float dis_x = x1 - coord[cell_2][0];
-	 float dis_y = y1 - coord[cell_2][1];
-	 float dis_z = z1 - coord[cell_2][2];
-	 ++local_distCounter[(unsigned int) (sqrtf((dis_x*dis_x + dis_y*dis_y + dis_z*dis_z)) * 100)];
-        }
-     }
-
-#pragma omp critical
-    {
-      for(size_t ix = 0; ix < MAX_DIST ; ++ix)
-	{
-	 dis_count[ix] += local_distCounter[ix];
-       }
+    // the saved pairs join the check, and the saved points its count
+    hist_add(dis_count, MAX_DIST, saved_counts, saved.nbins);
+    for (size_t ix = 0; ix < saved.nbins; ++ix)
+      pairs += saved_counts[ix];
+    expected += (uint64_t) old * (old - 1) / 2;
+  } else {
+    // the block pairs are split between the threads by their number of pairs
+    expected = (uint64_t) in[0].n * (in[0].n - (in[0].n > 0)) / 2;
+    if (budget_mb > 0) {
+      if (stream_count(&in[0].st, &bins, kernel, dis_count, &pairs) < 0)
+        exit(1);
+    } else if (cutoff) {
+      // the pairs in the range have every coordinate difference below the
+      // square root of the first squared distance beyond it, the pairs the
+      // grid does not compare all go to the last bin
+      grid_t grid;
+      uint32_t reach = ceil(sqrt((double) bins.thr[MAX_DIST - 1]));
+      if (grid_build(&grid, &in[0].cells, in[0].lo, in[0].hi, reach) < 0 ||
+          grid_run(&grid, &bins, kernel, dis_count, &pairs) < 0)
+        exit(1);
+      grid_free(&grid);
+      if (pairs <= expected) {
+        dis_count[MAX_DIST - 1] += expected - pairs;
+        pairs = expected;
+      }
+    } else {
+      tiles_t tiles;
+      tiles_self(&tiles, in[0].n, tile);
+      state.pairs = expected;
+      if (nshards > 0)
+        expected = tiles_shard(&tiles, shard, nshards);
+      pairs = tiles_run(&tiles, &in[0].cells, &in[0].cells, &bins, kernel, dis_count);
     }
   }
+  if (affinity != NUMA_OFF && budget_mb == 0)
+    for (int ix = 0; ix < ninputs; ++ix)
+      numa_report(in[ix].path, in[ix].cells.x,
+                  (char*) (in[ix].cells.z + in[ix].cells.n) - (char*) in[ix].cells.x);
+  for (int ix = 0; ix < nopen; ++ix)
+    if (budget_mb > 0)
+      stream_close(&in[ix].st);
+    else
+      cells_free(&in[ix].cells);
+
+  // every pair must have been counted exactly once
+  if (hist_check(dis_count, MAX_DIST, pairs, expected) < 0)
+    exit(1);
+  if (sampled)
+    fprintf(stderr, "sampled %lu of %lu pairs\n", (unsigned long) sample.size,
+            (unsigned long) sample.pairs);
+  else if (dis_count[MAX_DIST - 1] > 0)
+    fprintf(stderr, "%lu pairs beyond the maximum distance\n",
+            (unsigned long) dis_count[MAX_DIST - 1]);
+  // a shard keeps the pairs of all shards for merge to check
+  state.npoints = ninputs == 1 ? npoints : 0;
+  state.nbins = MAX_DIST;
+  state.shard = shard;
+  state.nshards = nshards > 0 ? nshards : 1;
+  state.pairs = nshards > 0 ? state.pairs : expected;
+  if (state_path && histio_write(state_path, &state, dis_count) < 0)
+    exit(1);
+  free(saved_counts);
 
-  for(size_t ix = 0; ix < MAX_DIST; ++ix)
-    {
-     if(dis_count[ix] >= 1)
-       {
-	 printf("%05.2f %d\n", ((float) ix ) / 100, dis_count[ix]);
-       }
+  // print the bin starts with as many decimals as the width needs, at least
+  // 2, or the counts and the header of a saved histogram
+  int prec = decimals(width, digits) > 2 ? decimals(width, digits) : 2;
+  if (sampled) {
+    uint64_t *errors = (uint64_t*) malloc(sizeof(uint64_t) * MAX_DIST);
+    if (errors == NULL) {
+      fprintf(stderr, "cannot allocate the errors of the estimates\n");
+      exit(1);
+    }
+    for (size_t ix = 0; ix < MAX_DIST; ++ix)
+      sample_estimate(&sample, dis_count[ix], dis_count + ix, errors + ix);
+    if (output_errors(STDOUT_FILENO, dis_count, errors, MAX_DIST, width, digits, prec, csv) < 0)
+      exit(1);
+    free(errors);
+  } else if (binary) {
+    if (histio_put(stdout, &state, dis_count) < 0) {
+      fprintf(stderr, "cannot write the histogram\n");
+      exit(1);
     }
+  } else if (output_text(STDOUT_FILENO, dis_count, MAX_DIST, width, digits, prec, csv) < 0) {
+    exit(1);
+  }
+  free(dis_count);
+  bins_free(&bins);
   return 0;
 }
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cells.h"
+
+// points stored by one thread at a time
+#define CELLS_BLOCK (1 << 16)
+
+int cells_alloc(cells_t *cells, size_t n) {
+  size_t stride = (n + CELLS_PAD - 1) / CELLS_PAD * CELLS_PAD + CELLS_PAD;
+  int16_t *mem = (int16_t*) aligned_alloc(CELLS_ALIGN, sizeof(int16_t) * 3 * stride);
+  if (mem == NULL) {
+    fprintf(stderr, "cannot allocate %zu cells\n", n);
+    return -1;
+  }
+  // the blocks are first touched by the threads that store them, so that
+  // their pages are spread over the nodes of the threads
+  size_t nblocks = (stride + CELLS_BLOCK - 1) / CELLS_BLOCK;
+#pragma omp parallel for
+  for (size_t bx = 0; bx < nblocks; ++bx) {
+    size_t first = bx * CELLS_BLOCK;
+    size_t len = stride - first < CELLS_BLOCK ? stride - first : CELLS_BLOCK;
+    for (int ax = 0; ax < 3; ++ax)
+      memset(mem + ax * stride + first, 0, sizeof(int16_t) * len);
+  }
+  cells->n = n;
+  cells->x = mem;
+  cells->y = mem + stride;
+  cells->z = mem + 2 * stride;
+  return 0;
+}
+
+size_t cells_store(cells_t *cells, size_t first, const int32_t *xyz, size_t n) {
+  for (size_t ix = 0; ix < n; ++ix) {
+    const int32_t *v = xyz + 3 * ix;
+    if (v[0] < -COORD_LIMIT || v[0] > COORD_LIMIT ||
+        v[1] < -COORD_LIMIT || v[1] > COORD_LIMIT ||
+        v[2] < -COORD_LIMIT || v[2] > COORD_LIMIT)
+      return ix + 1;
+    cells->x[first + ix] = v[0];
+    cells->y[first + ix] = v[1];
+    cells->z[first + ix] = v[2];
+  }
+  return 0;
+}
+
+void cells_range_error(const char *path, size_t line) {
+  fprintf(stderr, "%s:%zu: coordinate outside [-%d.%03d, %d.%03d]\n",
+          path, line, COORD_LIMIT / 1000, COORD_LIMIT % 1000,
+          COORD_LIMIT / 1000, COORD_LIMIT % 1000);
+}
+
+int cells_from_coords(cells_t *cells, const coords_t *coords, const char *path) {
+  if (cells_alloc(cells, coords->n) < 0)
+    return -1;
+  const size_t block = CELLS_BLOCK;
+  size_t nblocks = (coords->n + block - 1) / block, bad = 0;
+  // bad holds n - ix of the first bad line, so the max finds the earliest
+#pragma omp parallel for reduction(max: bad)
+  for (size_t bx = 0; bx < nblocks; ++bx) {
+    size_t first = bx * block;
+    size_t n = coords->n - first < block ? coords->n - first : block;
+    size_t ix = cells_store(cells, first, coords->xyz + 3 * first, n);
+    if (ix && coords->n - (first + ix - 1) > bad)
+      bad = coords->n - (first + ix - 1);
+  }
+  if (bad) {
+    cells_range_error(path, coords->n - bad + 1);
+    cells_free(cells);
+    return -1;
+  }
+  return 0;
+}
+
+void cells_free(cells_t *cells) {
+  free(cells->x);
+  cells->x = cells->y = cells->z = NULL;
+  cells->n = 0;
+}
+
+void cells_bounds(const cells_t *cells, int16_t lo[3], int16_t hi[3]) {
+  const int16_t *axes[3] = {cells->x, cells->y, cells->z};
+  for (int dx = 0; dx < 3; ++dx) {
+    int16_t l = INT16_MAX, h = INT16_MIN;
+    for (size_t ix = 0; ix < cells->n; ++ix) {
+      l = axes[dx][ix] < l ? axes[dx][ix] : l;
+      h = axes[dx][ix] > h ? axes[dx][ix] : h;
+    }
+    lo[dx] = l;
+    hi[dx] = h;
+  }
+}
+
+uint64_t cells_hash(const cells_t *cells, size_t begin, size_t end, uint64_t h) {
+  for (size_t ix = begin; ix < end; ++ix)
+    h = cells_hash_point(h, cells->x[ix], cells->y[ix], cells->z[ix]);
+  return h;
+}
@@ -0,0 +1,56 @@
+#ifndef CELLS_H
+#define CELLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "parse.h"
+
+// largest coordinate magnitude in thousandths, it keeps every coordinate
+// difference inside int16 and every squared distance below 2^31
+#define COORD_LIMIT 13376
+#define MAX_D2 ((uint32_t) 3 * (2 * COORD_LIMIT) * (2 * COORD_LIMIT))
+
+// arrays are padded to a multiple of CELLS_PAD and aligned to CELLS_ALIGN
+#define CELLS_PAD 32
+#define CELLS_ALIGN 64
+
+// coordinates in fixed point, scaled by 1000, as separate x, y, z arrays
+typedef struct {
+  size_t n;
+  int16_t *x, *y, *z;
+} cells_t;
+
+// allocate zeroed storage for n cells, returns -1 if out of memory
+int cells_alloc(cells_t *cells, size_t n);
+
+// narrow n parsed triples to int16 and store them from index first on
+// returns 0 on success, otherwise 1 + the index of the first triple that
+// is out of range
+size_t cells_store(cells_t *cells, size_t first, const int32_t *xyz, size_t n);
+
+// report a coordinate out of range on line of the file path
+void cells_range_error(const char *path, size_t line);
+
+// narrow parsed coordinates to int16, path is used for error messages
+// returns 0 on success, -1 after printing an error message
+int cells_from_coords(cells_t *cells, const coords_t *coords, const char *path);
+void cells_free(cells_t *cells);
+
+// bounding box of the cells, lo > hi on every axis if there are none
+void cells_bounds(const cells_t *cells, int16_t lo[3], int16_t hi[3]);
+
+// fingerprint of a sequence of points, chained one point at a time so the
+// hash of a file can be extended as lines are appended to it
+#define CELLS_HASH_SEED 0x243f6a8885a308d3ULL
+
+static inline uint64_t cells_hash_point(uint64_t h, int32_t x, int32_t y, int32_t z) {
+  uint64_t v = (uint64_t) (uint16_t) x | (uint64_t) (uint16_t) y << 16 |
+               (uint64_t) (uint16_t) z << 32;
+  h = (h ^ v) * 0x9e3779b97f4a7c15ULL;
+  return h ^ h >> 29;
+}
+
+// extend h by the cells in [begin, end)
+uint64_t cells_hash(const cells_t *cells, size_t begin, size_t end, uint64_t h);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "omp.h"
+#include "hist.h"
+#include "grid.h"
+
+// points given to a kernel at once, so the narrow histograms have room
+#define GRID_CHUNK 8192
+
+static size_t grid_cells(const grid_t *grid) {
+  return grid->dim[0] * grid->dim[1] * grid->dim[2];
+}
+
+// cells per axis for cells of side thousandths
+static void grid_dims(grid_t *grid, const int16_t lo[3], const int16_t hi[3], uint32_t side) {
+  grid->side = side;
+  for (int dx = 0; dx < 3; ++dx)
+    grid->dim[dx] = lo[dx] <= hi[dx] ? (size_t) (hi[dx] - lo[dx]) / side + 1 : 1;
+}
+
+int grid_build(grid_t *grid, const cells_t *cells, const int16_t lo[3], const int16_t hi[3],
+               uint32_t reach) {
+  size_t n = cells->n;
+  if (n >= UINT32_MAX) {
+    fprintf(stderr, "too many cells for the grid: %zu\n", n);
+    return -1;
+  }
+  // cells that would mostly be empty only cost memory and time, so the
+  // side grows until there are at most about two cells a point
+  size_t limit = 2 * n + 64;
+  grid_dims(grid, lo, hi, reach > 0 ? reach : 1);
+  while (grid_cells(grid) > limit)
+    grid_dims(grid, lo, hi, 2 * grid->side);
+  for (int dx = 0; dx < 3; ++dx)
+    grid->lo[dx] = lo[dx] <= hi[dx] ? lo[dx] : 0;
+
+  size_t ncells = grid_cells(grid);
+  if (cells_alloc(&grid->cells, n) < 0)
+    return -1;
+  uint32_t *cell = (uint32_t*) malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+  grid->start = (uint32_t*) calloc(ncells + 1, sizeof(uint32_t));
+  if (cell == NULL || grid->start == NULL) {
+    fprintf(stderr, "cannot allocate the grid of %zu cells\n", ncells);
+    free(cell);
+    grid_free(grid);
+    return -1;
+  }
+
+  // the cell of every point, then a counting sort that keeps the order of
+  // the points within a cell
+#pragma omp parallel for
+  for (size_t ix = 0; ix < n; ++ix) {
+    size_t cx = (uint32_t) (cells->x[ix] - grid->lo[0]) / grid->side;
+    size_t cy = (uint32_t) (cells->y[ix] - grid->lo[1]) / grid->side;
+    size_t cz = (uint32_t) (cells->z[ix] - grid->lo[2]) / grid->side;
+    cell[ix] = (cx * grid->dim[1] + cy) * grid->dim[2] + cz;
+  }
+  for (size_t ix = 0; ix < n; ++ix)
+    ++grid->start[cell[ix] + 1];
+  for (size_t cx = 0; cx < ncells; ++cx)
+    grid->start[cx + 1] += grid->start[cx];
+  for (size_t ix = 0; ix < n; ++ix) {
+    uint32_t at = grid->start[cell[ix]]++;
+    grid->cells.x[at] = cells->x[ix];
+    grid->cells.y[at] = cells->y[ix];
+    grid->cells.z[at] = cells->z[ix];
+  }
+  // the starts were moved to the ends of the cells
+  for (size_t cx = ncells; cx > 0; --cx)
+    grid->start[cx] = grid->start[cx - 1];
+  grid->start[0] = 0;
+  free(cell);
+  return 0;
+}
+
+void grid_free(grid_t *grid) {
+  cells_free(&grid->cells);
+  free(grid->start);
+  grid->start = NULL;
+}
+
+// the points of the cells (x, y, z - 1), (x, y, z), (x, y, z + 1) that are
+// in the grid, none if (x, y) is not
+static void grid_zrun(const grid_t *grid, long x, long y, long z, size_t *begin, size_t *end) {
+  *begin = *end = 0;
+  if (x < 0 || x >= (long) grid->dim[0] || y < 0 || y >= (long) grid->dim[1])
+    return;
+  size_t row = ((size_t) x * grid->dim[1] + y) * grid->dim[2];
+  size_t z0 = z > 0 ? z - 1 : 0, z1 = z + 1 < (long) grid->dim[2] ? z + 1 : z;
+  *begin = grid->start[row + z0];
+  *end = grid->start[row + z1 + 1];
+}
+
+// count the pairs of point ix with the points [begin, end)
+static void grid_count(const grid_t *grid, const bins_t *bins, kernel_fn kernel, size_t ix,
+                       size_t begin, size_t end, hist_t *hist) {
+  const cells_t *c = &grid->cells;
+  for (size_t n; begin < end; begin += n) {
+    n = end - begin < GRID_CHUNK ? end - begin : GRID_CHUNK;
+    hist_reserve(hist, n);
+    kernel(bins, c->x[ix], c->y[ix], c->z[ix], c->x + begin, c->y + begin, c->z + begin, n, hist);
+  }
+}
+
+// count the pairs of the points of cell (x, y, z) with the later points of
+// the cell and with the cells of its half shell
+static void grid_cell(const grid_t *grid, const bins_t *bins, kernel_fn kernel,
+                      size_t x, size_t y, size_t z, hist_t *hist) {
+  size_t row = (x * grid->dim[1] + y) * grid->dim[2];
+  size_t first = grid->start[row + z], last = grid->start[row + z + 1];
+  if (first == last)
+    return;
+  // the cell itself and (x, y, z + 1) are one run
+  size_t self_end = grid->start[row + (z + 1 < grid->dim[2] ? z + 2 : z + 1)];
+  size_t begin[4], end[4];
+  grid_zrun(grid, x, y + 1, z, begin, end);
+  for (int dy = -1; dy <= 1; ++dy)
+    grid_zrun(grid, x + 1, (long) y + dy, z, begin + 2 + dy, end + 2 + dy);
+  for (size_t ix = first; ix < last; ++ix) {
+    grid_count(grid, bins, kernel, ix, ix + 1, self_end, hist);
+    for (int rx = 0; rx < 4; ++rx)
+      grid_count(grid, bins, kernel, ix, begin[rx], end[rx], hist);
+  }
+}
+
+int grid_run(const grid_t *grid, const bins_t *bins, kernel_fn kernel, uint64_t *total,
+             uint64_t *pairs) {
+  hist_t *hists[omp_get_max_threads()];
+  size_t ncells = grid_cells(grid);
+  int failed = 0;
+  uint64_t counted = 0;
+#pragma omp parallel reduction(+: counted)
+  {
+    // every thread allocates and first touches its own histogram
+    int thrd = omp_get_thread_num(), nthrds = omp_get_num_threads();
+    hist_t hist;
+    hists[thrd] = &hist;
+    if (hist_init(&hist, bins->nbins) < 0) {
+#pragma omp atomic write
+      failed = 1;
+    }
+#pragma omp barrier
+    // cells hold very different numbers of points, they are handed out
+    // in small batches
+#pragma omp for schedule(dynamic, 64)
+    for (size_t cx = 0; cx < ncells; ++cx)
+      if (!failed)
+        grid_cell(grid, bins, kernel, cx / grid->dim[2] / grid->dim[1],
+                  cx / grid->dim[2] % grid->dim[1], cx % grid->dim[2], &hist);
+    if (hist.wide != NULL) {
+      hist_flush(&hist);
+      counted = hist.pairs;
+    }
+#pragma omp barrier
+    // every thread sums a slice of the bins over all threads
+    if (!failed)
+      hist_reduce(hists, nthrds, thrd, total);
+#pragma omp barrier
+    hist_free(&hist);
+  }
+  if (failed) {
+    fprintf(stderr, "cannot allocate the thread histograms\n");
+    return -1;
+  }
+  *pairs = counted;
+  return 0;
+}
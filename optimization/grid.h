@@ -0,0 +1,39 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cells.h"
+#include "bins.h"
+#include "kernel.h"
+
+// the points sorted into a uniform grid of cubic cells at least as wide as
+// the cutoff, so that the pairs closer than it lie in the same or in
+// neighbouring cells; cells are numbered with z fastest, so the cells
+// (x, y, z - 1), (x, y, z) and (x, y, z + 1) are one run of points
+//
+// every cell is owned by the thread counting its pairs with the 13 cells
+// after it in the half shell (x, y, z + 1), (x, y + 1, *), (x + 1, *, *),
+// so every pair is counted once and nothing is shared but the points
+typedef struct {
+  cells_t cells;      // the points sorted by cell
+  int16_t lo[3];      // corner of cell 0
+  uint32_t side;      // cell side in thousandths
+  size_t dim[3];      // cells per axis
+  uint32_t *start;    // first point of every cell, one more entry at the end
+} grid_t;
+
+// sort the cells with bounding box [lo, hi] into a grid of cells at least
+// reach wide, wider if there would be far more cells than points
+// returns 0 on success, -1 after printing an error message
+int grid_build(grid_t *grid, const cells_t *cells, const int16_t lo[3], const int16_t hi[3],
+               uint32_t reach);
+void grid_free(grid_t *grid);
+
+// count the pairs in the same or neighbouring cells with the current
+// OpenMP threads and add them to total, pairs is set to their number
+// returns 0 on success, -1 after printing an error message
+int grid_run(const grid_t *grid, const bins_t *bins, kernel_fn kernel, uint64_t *total,
+             uint64_t *pairs);
+
+#endif
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cells.h"
+#include "hist.h"
+
+int hist_init(hist_t *hist, size_t nbins) {
+  hist->nbins = nbins;
+  hist->stride = (nbins + 31) / 32 * 32;
+  hist->sub = (uint16_t*) aligned_alloc(CELLS_ALIGN, sizeof(uint16_t) * HIST_WAYS * hist->stride);
+  hist->wide = (uint64_t*) calloc(nbins, sizeof(uint64_t));
+  if (hist->sub == NULL || hist->wide == NULL) {
+    hist_free(hist);
+    return -1;
+  }
+  memset(hist->sub, 0, sizeof(uint16_t) * HIST_WAYS * hist->stride);
+  hist->room = HIST_ROOM;
+  hist->pairs = 0;
+  return 0;
+}
+
+void hist_free(hist_t *hist) {
+  free(hist->sub);
+  free(hist->wide);
+  hist->sub = NULL;
+  hist->wide = NULL;
+}
+
+void hist_flush(hist_t *hist) {
+  for (int wx = 0; wx < HIST_WAYS; ++wx) {
+    const uint16_t *sub = hist->sub + wx * hist->stride;
+    for (size_t ix = 0; ix < hist->nbins; ++ix)
+      hist->wide[ix] += sub[ix];
+  }
+  memset(hist->sub, 0, sizeof(uint16_t) * HIST_WAYS * hist->stride);
+  hist->room = HIST_ROOM;
+}
+
+void hist_reduce(hist_t *const *hists, int nthrds, int thrd, uint64_t *total) {
+  size_t nbins = hists[0]->nbins;
+  size_t begin = nbins * thrd / nthrds, end = nbins * (thrd + 1) / nthrds;
+  for (int tx = 0; tx < nthrds; ++tx) {
+    const uint64_t *wide = hists[tx]->wide;
+    for (size_t ix = begin; ix < end; ++ix)
+      total[ix] += wide[ix];
+  }
+}
+
+void hist_add(uint64_t *total, size_t nbins, const uint64_t *counts, size_t ncounts) {
+  for (size_t ix = 0; ix < ncounts; ++ix)
+    total[ix + 1 < ncounts && ix + 1 < nbins ? ix : nbins - 1] += counts[ix];
+}
+
+int hist_check(const uint64_t *total, size_t nbins, uint64_t counted, uint64_t expected) {
+  uint64_t sum = 0;
+  for (size_t ix = 0; ix < nbins; ++ix)
+    sum += total[ix];
+  if (counted != expected || sum != counted) {
+    fprintf(stderr, "lost pairs: %lu expected, %lu counted, %lu in the histogram\n",
+            (unsigned long) expected, (unsigned long) counted, (unsigned long) sum);
+    return -1;
+  }
+  return 0;
+}
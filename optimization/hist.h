@@ -0,0 +1,53 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// a thread's histogram: the kernels count into HIST_WAYS narrow 16-bit
+// sub-histograms, pair ix goes to way ix % HIST_WAYS so that repeated bins
+// in a row do not wait on each other's stores, and the sub-histograms are
+// flushed into 64-bit counters before any of them can overflow
+#define HIST_WAYS 4
+#define HIST_ROOM UINT16_MAX
+
+typedef struct {
+  size_t nbins;
+  size_t stride;      // counters per way, nbins rounded up
+  uint16_t *sub;      // HIST_WAYS narrow histograms
+  uint64_t *wide;
+  size_t room;        // counts every way can still take before a flush
+  uint64_t pairs;     // pairs counted since hist_init
+} hist_t;
+
+// returns -1 if out of memory
+int hist_init(hist_t *hist, size_t nbins);
+void hist_free(hist_t *hist);
+
+// add the narrow counters to the 64-bit ones and clear them
+void hist_flush(hist_t *hist);
+
+// make room for n more pairs, n / HIST_WAYS + 1 must be below HIST_ROOM
+static inline void hist_reserve(hist_t *hist, size_t n) {
+  size_t need = n / HIST_WAYS + 1;
+  if (need > hist->room)
+    hist_flush(hist);
+  hist->room -= need;
+  hist->pairs += n;
+}
+
+// sum the flushed histograms of nthrds threads into total, thread thrd
+// sums its share of the bins, every thread must call it between barriers
+void hist_reduce(hist_t *const *hists, int nthrds, int thrd, uint64_t *total);
+
+// add a histogram of ncounts counters, its last one for the pairs beyond
+// the range, to total of nbins counters; bins total has no room for go to
+// its last counter
+void hist_add(uint64_t *total, size_t nbins, const uint64_t *counts, size_t ncounts);
+
+// check that the kernels were given exactly the expected number of pairs
+// and that the histogram holds all of the counted ones
+// returns 0 on success, -1 after printing an error message
+int hist_check(const uint64_t *total, size_t nbins, uint64_t counted, uint64_t expected);
+
+#endif
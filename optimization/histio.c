@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "histio.h"
+
+#define HISTIO_MAGIC "CELLHIST"
+// version 1 had no shards, its files are read as whole histograms
+#define HISTIO_VERSION 2
+#define HISTIO_HEADER_V1 (8 + 4 + 4 + 6 * 8)
+#define HISTIO_HEADER (HISTIO_HEADER_V1 + 3 * 8)
+
+static void put64(unsigned char *p, uint64_t v) {
+  for (int bx = 0; bx < 8; ++bx)
+    p[bx] = v >> 8 * bx;
+}
+
+static uint64_t get64(const unsigned char *p) {
+  uint64_t v = 0;
+  for (int bx = 0; bx < 8; ++bx)
+    v |= (uint64_t) p[bx] << 8 * bx;
+  return v;
+}
+
+int histio_same_bins(const histio_t *a, const histio_t *b) {
+  return a->flags == b->flags && a->width == b->width &&
+         a->range == b->range && a->box == b->box;
+}
+
+int histio_put(FILE *f, const histio_t *hdr, const uint64_t *counts) {
+  unsigned char head[HISTIO_HEADER], buf[8 * 512];
+  memcpy(head, HISTIO_MAGIC, 8);
+  put64(head + 8, HISTIO_VERSION | (uint64_t) hdr->flags << 32);
+  put64(head + 16, hdr->width);
+  put64(head + 24, hdr->range);
+  put64(head + 32, hdr->box);
+  put64(head + 40, hdr->npoints);
+  put64(head + 48, hdr->hash);
+  put64(head + 56, hdr->nbins);
+  put64(head + 64, hdr->shard);
+  put64(head + 72, hdr->nshards);
+  put64(head + 80, hdr->pairs);
+  if (fwrite(head, 1, sizeof(head), f) != sizeof(head))
+    return -1;
+  for (size_t ix = 0; ix < hdr->nbins; ix += 512) {
+    size_t n = hdr->nbins - ix < 512 ? hdr->nbins - ix : 512;
+    for (size_t kx = 0; kx < n; ++kx)
+      put64(buf + 8 * kx, counts[ix + kx]);
+    if (fwrite(buf, 8, n, f) != n)
+      return -1;
+  }
+  return fflush(f) == 0 ? 0 : -1;
+}
+
+int histio_write(const char *path, const histio_t *hdr, const uint64_t *counts) {
+  // write a temporary file and rename it, so a failed run keeps the old one
+  size_t len = strlen(path);
+  char tmp[len + 5];
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".tmp", 5);
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot create %s\n", tmp);
+    return -1;
+  }
+  int ok = histio_put(f, hdr, counts) == 0;
+  if (fclose(f) != 0 || !ok || rename(tmp, path) != 0) {
+    fprintf(stderr, "cannot write %s\n", path);
+    remove(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+int histio_read(const char *path, histio_t *hdr, uint64_t **counts) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  unsigned char head[HISTIO_HEADER] = {0}, buf[8];
+  uint64_t version = 0;
+  if (fread(head, 1, HISTIO_HEADER_V1, f) == HISTIO_HEADER_V1) {
+    version = get64(head + 8);
+    hdr->flags = version >> 32;
+    hdr->width = get64(head + 16);
+    hdr->range = get64(head + 24);
+    hdr->box = get64(head + 32);
+    hdr->npoints = get64(head + 40);
+    hdr->hash = get64(head + 48);
+    hdr->nbins = get64(head + 56);
+  }
+  size_t more = HISTIO_HEADER - HISTIO_HEADER_V1;
+  if ((uint32_t) version == HISTIO_VERSION &&
+      fread(head + HISTIO_HEADER_V1, 1, more, f) == more) {
+    hdr->shard = get64(head + 64);
+    hdr->nshards = get64(head + 72);
+    hdr->pairs = get64(head + 80);
+  } else if ((uint32_t) version == 1) {
+    hdr->shard = 0;
+    hdr->nshards = 1;
+    hdr->pairs = 0;
+    version = HISTIO_VERSION;
+  }
+  if (memcmp(head, HISTIO_MAGIC, 8) != 0 || (uint32_t) version != HISTIO_VERSION ||
+      hdr->nbins == 0 || hdr->nbins > SIZE_MAX / 8 || hdr->shard >= hdr->nshards) {
+    fprintf(stderr, "%s is not a histogram file\n", path);
+    fclose(f);
+    return -1;
+  }
+  *counts = (uint64_t*) malloc(sizeof(uint64_t) * hdr->nbins);
+  if (*counts == NULL) {
+    fprintf(stderr, "cannot allocate %lu bins\n", (unsigned long) hdr->nbins);
+    fclose(f);
+    return -1;
+  }
+  for (size_t ix = 0; ix < hdr->nbins; ++ix) {
+    if (fread(buf, 1, 8, f) != 8) {
+      fprintf(stderr, "%s is truncated\n", path);
+      free(*counts);
+      *counts = NULL;
+      fclose(f);
+      return -1;
+    }
+    (*counts)[ix] = get64(buf);
+  }
+  fclose(f);
+  // a whole histogram holds all of its pairs
+  if (hdr->nshards == 1 && hdr->pairs == 0)
+    for (size_t ix = 0; ix < hdr->nbins; ++ix)
+      hdr->pairs += (*counts)[ix];
+  return 0;
+}
+
+int histio_merge(const char *const *paths, int npaths, histio_t *hdr, uint64_t **counts) {
+  uint64_t *part = NULL;
+  char *seen = NULL;
+  int ok = 1;
+  *counts = NULL;
+  for (int px = 0; px < npaths && ok; ++px) {
+    histio_t h;
+    if (histio_read(paths[px], &h, px ? &part : counts) < 0) {
+      ok = 0;
+    } else if (px == 0) {
+      *hdr = h;
+      seen = (char*) calloc(h.nshards, 1);
+      ok = seen != NULL;
+      if (!ok)
+        fprintf(stderr, "cannot allocate %lu shards\n", (unsigned long) h.nshards);
+    } else if (!histio_same_bins(&h, hdr) || h.nbins != hdr->nbins || h.npoints != hdr->npoints ||
+               h.hash != hdr->hash || h.nshards != hdr->nshards || h.pairs != hdr->pairs) {
+      fprintf(stderr, "%s is not a shard of the same histogram as %s\n", paths[px], paths[0]);
+      ok = 0;
+    } else {
+      for (size_t ix = 0; ix < h.nbins; ++ix)
+        (*counts)[ix] += part[ix];
+    }
+    free(part);
+    part = NULL;
+    if (ok && seen[h.shard]++) {
+      fprintf(stderr, "%s repeats shard %lu\n", paths[px], (unsigned long) h.shard);
+      ok = 0;
+    }
+  }
+  for (uint64_t sx = 0; ok && sx < hdr->nshards; ++sx)
+    if (!seen[sx]) {
+      fprintf(stderr, "shard %lu of %lu is missing\n", (unsigned long) sx,
+              (unsigned long) hdr->nshards);
+      ok = 0;
+    }
+  free(seen);
+  if (!ok) {
+    free(*counts);
+    *counts = NULL;
+    return -1;
+  }
+  hdr->shard = 0;
+  hdr->nshards = 1;
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef HISTIO_H
+#define HISTIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// a histogram saved to a file: a header with the options the bins were
+// made with and the points they cover, then one little-endian 64-bit
+// count per bin, the last one for the pairs beyond the range; a shard
+// holds part of the pairs, its shard number among nshards shards says
+// which, and the shards add up to all pairs
+#define HISTIO_SQUARED 1
+#define HISTIO_PERIODIC 2
+
+typedef struct {
+  uint32_t flags;     // HISTIO_SQUARED, HISTIO_PERIODIC
+  uint64_t width;     // bin width in thousandths, millionths if squared
+  uint64_t range;     // in the units of width, 0 for auto
+  uint64_t box;       // periodic box side in thousandths
+  uint64_t npoints;   // points of the input counted, 0 for two inputs
+  uint64_t hash;      // cells_hash fingerprint of those points, 0 for two inputs
+  uint64_t nbins;
+  uint64_t shard, nshards;
+  uint64_t pairs;     // of all shards together
+} histio_t;
+
+// whether two headers describe the same bins
+int histio_same_bins(const histio_t *a, const histio_t *b);
+
+// write the header and counts to f
+// returns 0 on success, -1 if f could not be written
+int histio_put(FILE *f, const histio_t *hdr, const uint64_t *counts);
+
+// write the header and counts to path, replacing it only once complete
+// returns 0 on success, -1 after printing an error message
+int histio_write(const char *path, const histio_t *hdr, const uint64_t *counts);
+
+// read a histogram written by histio_write, counts is allocated
+// returns 0 on success, -1 after printing an error message
+int histio_read(const char *path, histio_t *hdr, uint64_t **counts);
+
+// read the npaths shards of one histogram and add them up, every shard
+// must be there once; hdr is the header of the whole, counts is allocated
+// returns 0 on success, -1 after printing an error message
+int histio_merge(const char *const *paths, int npaths, histio_t *hdr, uint64_t **counts);
+
+#endif
@@ -0,0 +1,195 @@
+#include <string.h>
+#include <immintrin.h>
+#include "kernel.h"
+
+// add the bins b[0..n) of one vector to the narrow histograms, lane lx
+// goes to way lx % HIST_WAYS
+static inline void count_bins(hist_t *hist, const uint32_t *b, int n) {
+  uint16_t *sub = hist->sub;
+  size_t stride = hist->stride;
+  for (int lx = 0; lx < n; lx += HIST_WAYS)
+    for (int wx = 0; wx < HIST_WAYS; ++wx)
+      ++sub[wx * stride + b[lx + wx]];
+}
+
+// the kernels are written once with periodic as a compile time constant
+// and instantiated for open and periodic boundaries, with periodic set the
+// minimum image min(|d|, box - |d|) is taken on every axis
+static inline __attribute__((always_inline))
+int32_t min_image(int32_t d, int32_t box, const int periodic) {
+  if (!periodic)
+    return d;
+  d = d < 0 ? -d : d;
+  return d < box - d ? d : box - d;
+}
+
+static inline __attribute__((always_inline))
+void count_scalar(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                  const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                  size_t n, hist_t *hist, const int periodic) {
+  for (size_t ix = 0; ix < n; ++ix) {
+    int32_t dx = min_image(x - xs[ix], bins->box, periodic);
+    int32_t dy = min_image(y - ys[ix], bins->box, periodic);
+    int32_t dz = min_image(z - zs[ix], bins->box, periodic);
+    ++hist->sub[ix % HIST_WAYS * hist->stride + bins_lookup(bins, dx * dx + dy * dy + dz * dz)];
+  }
+}
+
+static void kernel_scalar(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                          const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                          size_t n, hist_t *hist) {
+  count_scalar(bins, x, y, z, xs, ys, zs, n, hist, 0);
+}
+
+static void kernel_scalar_periodic(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                                   const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                                   size_t n, hist_t *hist) {
+  count_scalar(bins, x, y, z, xs, ys, zs, n, hist, 1);
+}
+
+// 16 points per iteration: the int16 differences are interleaved so that
+// madd_epi16 yields dx^2 + dy^2 in 32 bits, the bins come from two gathers
+__attribute__((target("avx2")))
+static inline __m256i bins_avx2(const bins_t *bins, __m256i d2) {
+  __m256 f = _mm256_cvtepi32_ps(_mm256_max_epi32(d2, _mm256_set1_epi32(1)));
+  __m256i k = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(f), bins->shift),
+                               _mm256_set1_epi32(bins->base));
+  __m256i b = _mm256_i32gather_epi32((const int*) bins->lut, k, 4);
+  __m256i t = _mm256_i32gather_epi32((const int*) bins->thr + 1, b, 4);
+  // b + (d2 >= t) == b + 1 + (t > d2 ? -1 : 0)
+  return _mm256_add_epi32(b, _mm256_add_epi32(_mm256_set1_epi32(1), _mm256_cmpgt_epi32(t, d2)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i min_image_avx2(__m256i d, __m256i box, const int periodic) {
+  if (!periodic)
+    return d;
+  d = _mm256_abs_epi16(d);
+  return _mm256_min_epi16(d, _mm256_sub_epi16(box, d));
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline void count_avx2(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                              const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                              size_t n, hist_t *hist, const int periodic) {
+  const __m256i vbox = _mm256_set1_epi16(bins->box);
+  const __m256i vx = _mm256_set1_epi16(x);
+  const __m256i vy = _mm256_set1_epi16(y);
+  const __m256i vz = _mm256_set1_epi16(z);
+  const __m256i zero = _mm256_setzero_si256();
+  uint32_t b[16];
+  size_t ix = 0;
+  for (; ix + 16 <= n; ix += 16) {
+    __m256i dx = min_image_avx2(_mm256_sub_epi16(vx, _mm256_loadu_si256((const __m256i*) (xs + ix))),
+                                vbox, periodic);
+    __m256i dy = min_image_avx2(_mm256_sub_epi16(vy, _mm256_loadu_si256((const __m256i*) (ys + ix))),
+                                vbox, periodic);
+    __m256i dz = min_image_avx2(_mm256_sub_epi16(vz, _mm256_loadu_si256((const __m256i*) (zs + ix))),
+                                vbox, periodic);
+    __m256i xy_lo = _mm256_unpacklo_epi16(dx, dy), xy_hi = _mm256_unpackhi_epi16(dx, dy);
+    __m256i z_lo = _mm256_unpacklo_epi16(dz, zero), z_hi = _mm256_unpackhi_epi16(dz, zero);
+    __m256i d2_lo = _mm256_add_epi32(_mm256_madd_epi16(xy_lo, xy_lo), _mm256_madd_epi16(z_lo, z_lo));
+    __m256i d2_hi = _mm256_add_epi32(_mm256_madd_epi16(xy_hi, xy_hi), _mm256_madd_epi16(z_hi, z_hi));
+    _mm256_storeu_si256((__m256i*) b, bins_avx2(bins, d2_lo));
+    _mm256_storeu_si256((__m256i*) (b + 8), bins_avx2(bins, d2_hi));
+    count_bins(hist, b, 16);
+  }
+  count_scalar(bins, x, y, z, xs + ix, ys + ix, zs + ix, n - ix, hist, periodic);
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                        const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                        size_t n, hist_t *hist) {
+  count_avx2(bins, x, y, z, xs, ys, zs, n, hist, 0);
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2_periodic(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                                 const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                                 size_t n, hist_t *hist) {
+  count_avx2(bins, x, y, z, xs, ys, zs, n, hist, 1);
+}
+
+// 32 points per iteration, same scheme as the avx2 kernel
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i bins_avx512(const bins_t *bins, __m512i d2) {
+  __m512 f = _mm512_cvtepi32_ps(_mm512_max_epi32(d2, _mm512_set1_epi32(1)));
+  __m512i k = _mm512_sub_epi32(_mm512_srli_epi32(_mm512_castps_si512(f), bins->shift),
+                               _mm512_set1_epi32(bins->base));
+  __m512i b = _mm512_i32gather_epi32(k, (const int*) bins->lut, 4);
+  __m512i t = _mm512_i32gather_epi32(b, (const int*) bins->thr + 1, 4);
+  return _mm512_mask_add_epi32(b, _mm512_cmpge_epi32_mask(d2, t), b, _mm512_set1_epi32(1));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i min_image_avx512(__m512i d, __m512i box, const int periodic) {
+  if (!periodic)
+    return d;
+  d = _mm512_abs_epi16(d);
+  return _mm512_min_epi16(d, _mm512_sub_epi16(box, d));
+}
+
+__attribute__((target("avx512f,avx512bw"), always_inline))
+static inline void count_avx512(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                                const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                                size_t n, hist_t *hist, const int periodic) {
+  const __m512i vbox = _mm512_set1_epi16(bins->box);
+  const __m512i vx = _mm512_set1_epi16(x);
+  const __m512i vy = _mm512_set1_epi16(y);
+  const __m512i vz = _mm512_set1_epi16(z);
+  const __m512i zero = _mm512_setzero_si512();
+  uint32_t b[32];
+  size_t ix = 0;
+  for (; ix + 32 <= n; ix += 32) {
+    __m512i dx = min_image_avx512(_mm512_sub_epi16(vx, _mm512_loadu_si512(xs + ix)), vbox, periodic);
+    __m512i dy = min_image_avx512(_mm512_sub_epi16(vy, _mm512_loadu_si512(ys + ix)), vbox, periodic);
+    __m512i dz = min_image_avx512(_mm512_sub_epi16(vz, _mm512_loadu_si512(zs + ix)), vbox, periodic);
+    __m512i xy_lo = _mm512_unpacklo_epi16(dx, dy), xy_hi = _mm512_unpackhi_epi16(dx, dy);
+    __m512i z_lo = _mm512_unpacklo_epi16(dz, zero), z_hi = _mm512_unpackhi_epi16(dz, zero);
+    __m512i d2_lo = _mm512_add_epi32(_mm512_madd_epi16(xy_lo, xy_lo), _mm512_madd_epi16(z_lo, z_lo));
+    __m512i d2_hi = _mm512_add_epi32(_mm512_madd_epi16(xy_hi, xy_hi), _mm512_madd_epi16(z_hi, z_hi));
+    _mm512_storeu_si512(b, bins_avx512(bins, d2_lo));
+    _mm512_storeu_si512(b + 16, bins_avx512(bins, d2_hi));
+    count_bins(hist, b, 32);
+  }
+  count_scalar(bins, x, y, z, xs + ix, ys + ix, zs + ix, n - ix, hist, periodic);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void kernel_avx512(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                          const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                          size_t n, hist_t *hist) {
+  count_avx512(bins, x, y, z, xs, ys, zs, n, hist, 0);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void kernel_avx512_periodic(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                                   const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                                   size_t n, hist_t *hist) {
+  count_avx512(bins, x, y, z, xs, ys, zs, n, hist, 1);
+}
+
+kernel_fn kernel_select(const char *name, int periodic, const char **selected) {
+  static const struct {
+    const char *name;
+    kernel_fn fn[2];
+  } kernels[] = {
+    {"avx512", {kernel_avx512, kernel_avx512_periodic}},
+    {"avx2", {kernel_avx2, kernel_avx2_periodic}},
+    {"scalar", {kernel_scalar, kernel_scalar_periodic}},
+  };
+  __builtin_cpu_init();
+  int supported[] = {
+    __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"),
+    __builtin_cpu_supports("avx2"),
+    1,
+  };
+  for (size_t kx = 0; kx < sizeof(kernels) / sizeof(kernels[0]); ++kx)
+    if (supported[kx] && (name == NULL || strcmp(name, kernels[kx].name) == 0)) {
+      if (selected)
+        *selected = kernels[kx].name;
+      return kernels[kx].fn[periodic != 0];
+    }
+  return NULL;
+}
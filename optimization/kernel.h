@@ -0,0 +1,21 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bins.h"
+#include "hist.h"
+
+// count the distances between the point (x, y, z) and the n points
+// xs[ix], ys[ix], zs[ix] into the narrow histograms of hist, room for n
+// pairs must have been reserved
+typedef void (*kernel_fn)(const bins_t *bins, int16_t x, int16_t y, int16_t z,
+                          const int16_t *xs, const int16_t *ys, const int16_t *zs,
+                          size_t n, hist_t *hist);
+
+// pick the widest kernel the cpu supports, or the one called name, for
+// open or periodic boundaries
+// returns NULL if name is unknown or not supported
+kernel_fn kernel_select(const char *name, int periodic, const char **selected);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "omp.h"
+#include "output.h"
+
+static int num_digits(uint64_t v) {
+  int n = 1;
+  for (; v >= 10; v /= 10)
+    ++n;
+  return n;
+}
+
+// write v with exactly n digits, zero padded, returns the end
+static char *put_digits(char *p, uint64_t v, int n) {
+  for (int ix = n - 1; ix >= 0; --ix, v /= 10)
+    p[ix] = '0' + v % 10;
+  return p + n;
+}
+
+// the length of the line of bin ix, 0 if it is empty
+static size_t line_len(uint64_t count, size_t ix, uint64_t width, uint64_t scale, int prec) {
+  if (count == 0)
+    return 0;
+  int whole = num_digits(ix * width / scale);
+  return (whole > 2 ? whole : 2) + 1 + prec + 1 + num_digits(count) + 1;
+}
+
+static char *put_line(char *p, uint64_t count, size_t ix, uint64_t width, uint64_t scale,
+                      uint64_t drop, int prec, char sep) {
+  uint64_t start = ix * width, whole = start / scale;
+  int n = num_digits(whole);
+  p = put_digits(p, whole, n > 2 ? n : 2);
+  *p++ = '.';
+  p = put_digits(p, start % scale / drop, prec);
+  *p++ = sep;
+  p = put_digits(p, count, num_digits(count));
+  *p++ = '\n';
+  return p;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t done = write(fd, buf, len);
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0) {
+      fprintf(stderr, "cannot write the histogram\n");
+      return -1;
+    }
+    buf += done;
+    len -= done;
+  }
+  return 0;
+}
+
+int output_text(int fd, const uint64_t *counts, size_t nbins, uint64_t width,
+                int digits, int prec, int csv) {
+  uint64_t scale = 1, drop = 1;
+  for (int dx = 0; dx < digits; ++dx)
+    scale *= 10;
+  for (int dx = prec; dx < digits; ++dx)
+    drop *= 10;
+  const char *head = csv ? "start,count\n" : "";
+  size_t nhead = strlen(head), nlines = nbins > 0 ? nbins - 1 : 0;
+
+  int nthrds = omp_get_max_threads();
+  size_t at[nthrds + 1];
+  char *buf = NULL;
+  int failed = 0;
+#pragma omp parallel num_threads(nthrds)
+  {
+    // the threads may be fewer than asked for
+    int nt = omp_get_num_threads(), thrd = omp_get_thread_num();
+    size_t begin = nlines * thrd / nt, end = nlines * (thrd + 1) / nt;
+    size_t len = 0;
+    for (size_t ix = begin; ix < end; ++ix)
+      len += line_len(counts[ix], ix, width, scale, prec);
+    at[thrd + 1] = len;
+#pragma omp barrier
+#pragma omp single
+    {
+      at[0] = nhead;
+      for (int tx = 0; tx < nt; ++tx)
+        at[tx + 1] += at[tx];
+      buf = (char*) malloc(at[nt] + 1);
+      failed = buf == NULL;
+    }
+    if (!failed) {
+      char *p = buf + at[thrd];
+      for (size_t ix = begin; ix < end; ++ix)
+        if (counts[ix])
+          p = put_line(p, counts[ix], ix, width, scale, drop, prec, csv ? ',' : ' ');
+    }
+    if (thrd == 0)
+      nthrds = nt;
+  }
+  if (failed) {
+    fprintf(stderr, "cannot allocate the output buffer\n");
+    return -1;
+  }
+  memcpy(buf, head, nhead);
+  int ret = write_all(fd, buf, at[nthrds]);
+  free(buf);
+  return ret;
+}
+
+int output_errors(int fd, const uint64_t *counts, const uint64_t *errors, size_t nbins,
+                  uint64_t width, int digits, int prec, int csv) {
+  uint64_t scale = 1, drop = 1;
+  for (int dx = 0; dx < digits; ++dx)
+    scale *= 10;
+  for (int dx = prec; dx < digits; ++dx)
+    drop *= 10;
+  const char *head = csv ? "start,count,error\n" : "";
+  size_t nhead = strlen(head), nlines = nbins > 0 ? nbins - 1 : 0, len = nhead;
+  for (size_t ix = 0; ix < nlines; ++ix)
+    if (counts[ix])
+      len += line_len(counts[ix], ix, width, scale, prec) + num_digits(errors[ix]) + 1;
+  char *buf = (char*) malloc(len + 1);
+  if (buf == NULL) {
+    fprintf(stderr, "cannot allocate the output buffer\n");
+    return -1;
+  }
+  // the line of the count, its newline turned into a separator before the error
+  memcpy(buf, head, nhead);
+  char *p = buf + nhead;
+  for (size_t ix = 0; ix < nlines; ++ix)
+    if (counts[ix]) {
+      p = put_line(p, counts[ix], ix, width, scale, drop, prec, csv ? ',' : ' ');
+      p[-1] = csv ? ',' : ' ';
+      p = put_digits(p, errors[ix], num_digits(errors[ix]));
+      *p++ = '\n';
+    }
+  int ret = write_all(fd, buf, len);
+  free(buf);
+  return ret;
+}
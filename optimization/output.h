@@ -0,0 +1,24 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the non-empty bins of a histogram as lines "start count", or
+// "start,count" after a header line if csv is set; bin starts are
+// ix * width in units of 10^-digits, printed with prec decimals and at
+// least two integer digits; the last bin, beyond the range, is left out
+//
+// the lines are formatted in parallel straight into one buffer, every
+// thread measures its share of the bins first to find where it starts,
+// and the buffer goes to fd in a single write
+// returns 0 on success, -1 after printing an error message
+int output_text(int fd, const uint64_t *counts, size_t nbins, uint64_t width,
+                int digits, int prec, int csv);
+
+// the same lines with the half width of the confidence interval of every
+// count after it, "start count error", formatted by one thread
+int output_errors(int fd, const uint64_t *counts, const uint64_t *errors, size_t nbins,
+                  uint64_t width, int digits, int prec, int csv);
+
+#endif
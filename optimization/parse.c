@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "omp.h"
+#include "parse.h"
+
+size_t count_lines(const char *buf, size_t len) {
+  size_t count = 0;
+  const char *p = buf, *end = buf + len;
+  while (p < end) {
+    const char *nl = memchr(p, '\n', end - p);
+    ++count;
+    if (nl == NULL)
+      break;
+    p = nl + 1;
+  }
+  return count;
+}
+
+// decode one "+dd.ddd" field, returns 0 if the field is malformed
+static inline int parse_field(const char *p, int32_t *value) {
+  unsigned d0 = p[1] - '0', d1 = p[2] - '0';
+  unsigned d2 = p[4] - '0', d3 = p[5] - '0', d4 = p[6] - '0';
+  if ((p[0] != '+' && p[0] != '-') || p[3] != '.' ||
+      d0 > 9 || d1 > 9 || d2 > 9 || d3 > 9 || d4 > 9)
+    return 0;
+  int32_t v = d0 * 10000 + d1 * 1000 + d2 * 100 + d3 * 10 + d4;
+  *value = p[0] == '-' ? -v : v;
+  return 1;
+}
+
+size_t parse_buf(const char *buf, size_t len, size_t line0, int32_t *xyz) {
+  const char *p = buf, *end = buf + len;
+  for (size_t ix = 0; p < end; ++ix, p += LINE_LEN + 1) {
+    // the last line of the file may come without a newline
+    size_t left = end - p;
+    if (left < LINE_LEN || (left > LINE_LEN && p[LINE_LEN] != '\n') ||
+        p[7] != ' ' || p[15] != ' ' ||
+        !parse_field(p, xyz + 3 * ix) ||
+        !parse_field(p + 8, xyz + 3 * ix + 1) ||
+        !parse_field(p + 16, xyz + 3 * ix + 2))
+      return line0 + ix;
+  }
+  return 0;
+}
+
+int parse_decimal(const char *s, int digits, uint64_t *value) {
+  uint64_t v = 0;
+  int seen = 0, decimals = -1;
+  for (; *s; ++s) {
+    if (*s == '.' && decimals < 0) {
+      decimals = 0;
+      continue;
+    }
+    if (*s < '0' || *s > '9' || v > UINT64_MAX / 100)
+      return -1;
+    if (decimals >= 0 && ++decimals > digits)
+      return -1;
+    v = v * 10 + (*s - '0');
+    seen = 1;
+  }
+  if (!seen)
+    return -1;
+  for (decimals = decimals < 0 ? 0 : decimals; decimals < digits; ++decimals)
+    v *= 10;
+  *value = v;
+  return 0;
+}
+
+int parse_file(const char *path, int nthrds, coords_t *coords) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    fprintf(stderr, "cannot stat %s\n", path);
+    close(fd);
+    return -1;
+  }
+  size_t len = st.st_size;
+  coords->n = 0;
+  coords->xyz = NULL;
+  if (len == 0) {
+    close(fd);
+    return 0;
+  }
+  char *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "cannot map %s\n", path);
+    return -1;
+  }
+  madvise(map, len, MADV_SEQUENTIAL);
+
+  // split the file into one chunk per thread, every chunk starts at a line
+  size_t nchunks = nthrds > 0 ? nthrds : 1;
+  size_t begin[nchunks + 1], lines[nchunks + 1], bad[nchunks];
+  begin[0] = 0;
+  for (size_t cx = 1; cx < nchunks; ++cx) {
+    size_t pos = len * cx / nchunks;
+    if (pos < begin[cx - 1])
+      pos = begin[cx - 1];
+    const char *nl = pos < len ? memchr(map + pos, '\n', len - pos) : NULL;
+    begin[cx] = nl ? nl - map + 1 : len;
+  }
+  begin[nchunks] = len;
+
+  // count the lines of every chunk to find the line each chunk starts at
+#pragma omp parallel for num_threads(nchunks) schedule(static, 1)
+  for (size_t cx = 0; cx < nchunks; ++cx)
+    lines[cx + 1] = count_lines(map + begin[cx], begin[cx + 1] - begin[cx]);
+  lines[0] = 0;
+  for (size_t cx = 0; cx < nchunks; ++cx)
+    lines[cx + 1] += lines[cx];
+
+  coords->n = lines[nchunks];
+  coords->xyz = (int32_t*) malloc(sizeof(int32_t) * 3 * coords->n);
+  if (coords->xyz == NULL) {
+    fprintf(stderr, "cannot allocate %zu coordinates\n", coords->n);
+    munmap(map, len);
+    return -1;
+  }
+
+#pragma omp parallel for num_threads(nchunks) schedule(static, 1)
+  for (size_t cx = 0; cx < nchunks; ++cx)
+    bad[cx] = parse_buf(map + begin[cx], begin[cx + 1] - begin[cx],
+                        lines[cx] + 1, coords->xyz + 3 * lines[cx]);
+  munmap(map, len);
+
+  // report the first bad line of the file
+  for (size_t cx = 0; cx < nchunks; ++cx)
+    if (bad[cx]) {
+      fprintf(stderr, "%s:%zu: malformed line, expected \"+dd.ddd +dd.ddd +dd.ddd\"\n",
+              path, bad[cx]);
+      free(coords->xyz);
+      coords->xyz = NULL;
+      coords->n = 0;
+      return -1;
+    }
+  return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// every line of a cells file has the fixed layout "+01.330 -09.035 +03.489"
+#define LINE_LEN 23
+
+// parsed coordinates, stored as integers in thousandths
+typedef struct {
+  size_t n;
+  int32_t *xyz;   // n triples x, y, z
+} coords_t;
+
+// count the lines in buf, a last line without '\n' counts as well
+size_t count_lines(const char *buf, size_t len);
+
+// decode the complete lines in buf into xyz, line0 is the line number of
+// the first line (used for error messages only)
+// returns 0 on success, otherwise the line number of the first bad line
+size_t parse_buf(const char *buf, size_t len, size_t line0, int32_t *xyz);
+
+// parse a non-negative decimal number such as "0.01" into an integer scaled
+// by 10^digits, returns -1 if s is malformed or has more decimals
+int parse_decimal(const char *s, int digits, uint64_t *value);
+
+// read and decode a whole cells file using nthrds threads
+// returns 0 on success, -1 after printing an error message
+int parse_file(const char *path, int nthrds, coords_t *coords);
+
+#endif
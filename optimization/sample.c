@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "omp.h"
+#include "hist.h"
+#include "sample.h"
+
+#define GOLDEN 0x9e3779b97f4a7c15ULL
+
+// the SplitMix64 output function
+static inline uint64_t mix(uint64_t z) {
+  z = (z ^ z >> 30) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ z >> 27) * 0x94d049bb133111ebULL;
+  return z ^ z >> 31;
+}
+
+static void sample_plan(sample_t *sample, size_t na, size_t nb, int self, uint64_t size,
+                        uint64_t seed, int stream) {
+  sample->na = na;
+  sample->nb = nb;
+  sample->self = self;
+  sample->pairs = self ? (uint64_t) na * (na - (na > 0)) / 2 : (uint64_t) na * nb;
+  sample->size = size < sample->pairs ? size : sample->pairs;
+  sample->key = mix(seed * 2 + stream);
+}
+
+void sample_self(sample_t *sample, size_t n, uint64_t size, uint64_t seed, int stream) {
+  sample_plan(sample, n, n, 1, size, seed, stream);
+}
+
+void sample_cross(sample_t *sample, size_t na, size_t nb, uint64_t size, uint64_t seed,
+                  int stream) {
+  sample_plan(sample, na, nb, 0, size, seed, stream);
+}
+
+// pairs of the rows before row r of n points, row i pairs with the n - 1 - i
+// later points
+static inline uint64_t rows_before(uint64_t n, uint64_t r) {
+  return r * n - r * (r + 1) / 2;
+}
+
+// the points of pair p
+static void sample_locate(const sample_t *sample, uint64_t p, size_t *i, size_t *j) {
+  if (!sample->self) {
+    *i = p / sample->nb;
+    *j = p % sample->nb;
+    return;
+  }
+  // the root of rows_before(n, r) = p, corrected for its rounding
+  uint64_t n = sample->na;
+  double m = n - 0.5;
+  uint64_t r = (uint64_t) (m - sqrt(fmax(0, m * m - 2.0 * p)));
+  while (r > 0 && rows_before(n, r) > p)
+    --r;
+  while (rows_before(n, r + 1) <= p)
+    ++r;
+  *i = r;
+  *j = r + 1 + (p - rows_before(n, r));
+}
+
+static inline int32_t min_image(int32_t d, int32_t box) {
+  if (box == 0)
+    return d;
+  d = d < 0 ? -d : d;
+  return d < box - d ? d : box - d;
+}
+
+// count the pairs of the strata [begin, end)
+static void sample_count(const sample_t *sample, const cells_t *a, const cells_t *b,
+                         const bins_t *bins, uint64_t begin, uint64_t end, hist_t *hist) {
+  for (uint64_t k = begin; k < end; ++k) {
+    uint64_t lo = (unsigned __int128) sample->pairs * k / sample->size;
+    uint64_t hi = (unsigned __int128) sample->pairs * (k + 1) / sample->size;
+    uint64_t r = mix(sample->key + (k + 1) * GOLDEN);
+    size_t i, j;
+    sample_locate(sample, lo + (uint64_t) ((unsigned __int128) r * (hi - lo) >> 64), &i, &j);
+    int32_t dx = min_image(a->x[i] - b->x[j], bins->box);
+    int32_t dy = min_image(a->y[i] - b->y[j], bins->box);
+    int32_t dz = min_image(a->z[i] - b->z[j], bins->box);
+    ++hist->wide[bins_lookup(bins, dx * dx + dy * dy + dz * dz)];
+  }
+  hist->pairs += end - begin;
+}
+
+int sample_run(const sample_t *sample, const cells_t *a, const cells_t *b, const bins_t *bins,
+               uint64_t *total) {
+  hist_t *hists[omp_get_max_threads()];
+  int failed = 0;
+#pragma omp parallel
+  {
+    // every thread draws a run of strata into its own histogram, the
+    // random pairs are counted straight into the wide counters
+    int thrd = omp_get_thread_num(), nthrds = omp_get_num_threads();
+    hist_t hist;
+    hists[thrd] = &hist;
+    if (hist_init(&hist, bins->nbins) < 0) {
+#pragma omp atomic write
+      failed = 1;
+    } else {
+      sample_count(sample, a, b, bins, sample->size * thrd / nthrds,
+                   sample->size * (thrd + 1) / nthrds, &hist);
+    }
+#pragma omp barrier
+    if (!failed)
+      hist_reduce(hists, nthrds, thrd, total);
+#pragma omp barrier
+    hist_free(&hist);
+  }
+  if (failed) {
+    fprintf(stderr, "cannot allocate the thread histograms\n");
+    return -1;
+  }
+  return 0;
+}
+
+uint64_t sample_needed(const sample_t *pilot, const uint64_t *counts, size_t nbins,
+                       double relerr) {
+  // the last bin, beyond the range, is not printed and does not count
+  uint64_t sum = 0, top = 0;
+  for (size_t ix = 0; ix < nbins; ++ix) {
+    sum += counts[ix];
+    top = ix + 1 < nbins && counts[ix] > top ? counts[ix] : top;
+  }
+  if (top == 0)
+    return pilot->size;
+  // a bin with share p of the pairs has a relative half width of
+  // z sqrt((1 - p) / (size p)) in a sample of size pairs
+  double share = (double) top / sum < SAMPLE_SHARE ? (double) top / sum : SAMPLE_SHARE;
+  double need = 0;
+  for (size_t ix = 0; ix + 1 < nbins; ++ix) {
+    double p = (double) counts[ix] / sum;
+    if (counts[ix] > 0 && p >= share) {
+      double n = SAMPLE_Z * SAMPLE_Z * (1 - p) / (relerr * relerr * p);
+      need = n > need ? n : need;
+    }
+  }
+  return need < 0x1p63 ? (uint64_t) ceil(need) : UINT64_MAX;
+}
+
+void sample_estimate(const sample_t *sample, uint64_t count, uint64_t *estimate,
+                     uint64_t *error) {
+  if (sample->size == 0) {
+    *estimate = *error = 0;
+    return;
+  }
+  // the binomial variance, which bounds the one of a stratified sample,
+  // shrunk as the sample covers more of the pairs, to 0 for all of them
+  double p = (double) count / sample->size, pairs = sample->pairs;
+  double fpc = pairs > 1 ? (pairs - sample->size) / (pairs - 1) : 0;
+  *estimate = llround(p * pairs);
+  *error = ceil(SAMPLE_Z * pairs * sqrt(p * (1 - p) / sample->size * fpc));
+}
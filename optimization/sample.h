@@ -0,0 +1,53 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cells.h"
+#include "bins.h"
+
+// a stratified random sample of the pairs: the pairs are numbered row by
+// row, as tiles_count visits them, and cut into size strata of equal
+// length, one pair is drawn from every stratum
+//
+// the draw of stratum k is the k-th number of a counter-based generator,
+// SplitMix64 jumped straight to position k, so a thread can start at any
+// stratum and the sample only depends on the seed, not on the threads
+#define SAMPLE_PILOT (1 << 16)  // pairs of the pilot sample for a relative error
+#define SAMPLE_SHARE 0.01       // bins with this share of the pairs meet it
+#define SAMPLE_Z 1.96           // 95% confidence
+
+typedef struct {
+  size_t na, nb;      // number of points of the two sets
+  int self;           // pairs within one set, na == nb
+  uint64_t pairs;     // all pairs
+  uint64_t size;      // pairs drawn, at most all of them
+  uint64_t key;       // the generator's stream
+} sample_t;
+
+// plan a sample of size pairs within one set of n points, or between a
+// set of na and a set of nb points, stream tells apart the samples drawn
+// with the same seed
+void sample_self(sample_t *sample, size_t n, uint64_t size, uint64_t seed, int stream);
+void sample_cross(sample_t *sample, size_t na, size_t nb, uint64_t size, uint64_t seed,
+                  int stream);
+
+// draw the pairs with the current OpenMP threads and count them into
+// total, raw counts of the sample
+// returns 0 on success, -1 after printing an error message
+int sample_run(const sample_t *sample, const cells_t *a, const cells_t *b, const bins_t *bins,
+               uint64_t *total);
+
+// the pairs a sample must have for the relative error relerr, at 95%
+// confidence, in every bin with at least SAMPLE_SHARE of the pairs, or
+// in the fullest bin if none has that many, judged from the counts of a
+// smaller sample
+uint64_t sample_needed(const sample_t *pilot, const uint64_t *counts, size_t nbins,
+                       double relerr);
+
+// the estimate of a bin of all pairs from its count in the sample and the
+// half width of its confidence interval
+void sample_estimate(const sample_t *sample, uint64_t count, uint64_t *estimate,
+                     uint64_t *error);
+
+#endif
@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "parse.h"
+#include "tiles.h"
+#include "stream.h"
+
+// bytes read from the file at once, a multiple of the line length
+#define READ_BUF ((LINE_LEN + 1) << 16)
+
+// decoded lines of one buffer, starting at line (1-based) and file offset pos
+typedef int (*lines_fn)(stream_t *st, const int32_t *xyz, size_t n, size_t line, off_t pos);
+
+// read the lines in [pos, end) of the file in buffers, decode them and
+// hand them to fn
+static int stream_read(stream_t *st, off_t pos, off_t end, size_t line, lines_fn fn) {
+  size_t have = 0;
+  off_t start = pos;
+  while (pos < end || have) {
+    size_t want = READ_BUF - have < (size_t) (end - pos) ? READ_BUF - have : end - pos;
+    ssize_t got = pread(st->fd, st->buf + have, want, pos);
+    if (got < 0 || (got == 0 && want > 0)) {
+      fprintf(stderr, "cannot read %s\n", st->path);
+      return -1;
+    }
+    have += got;
+    pos += got;
+
+    // decode the complete lines, the rest is kept for the next read
+    size_t use = have;
+    if (pos < end) {
+      char *nl = memrchr(st->buf, '\n', have);
+      if (nl == NULL) {
+        fprintf(stderr, "%s:%zu: malformed line, expected \"+dd.ddd +dd.ddd +dd.ddd\"\n",
+                st->path, line);
+        return -1;
+      }
+      use = nl - st->buf + 1;
+    }
+    size_t bad = parse_buf(st->buf, use, line, st->xyz);
+    if (bad) {
+      fprintf(stderr, "%s:%zu: malformed line, expected \"+dd.ddd +dd.ddd +dd.ddd\"\n",
+              st->path, bad);
+      return -1;
+    }
+    size_t lines = (use + LINE_LEN) / (LINE_LEN + 1);
+    if (fn(st, st->xyz, lines, line, start) < 0)
+      return -1;
+    line += lines;
+    start += use;
+    memmove(st->buf, st->buf + use, have - use);
+    have -= use;
+  }
+  return 0;
+}
+
+static int push_offset(stream_t *st, off_t pos) {
+  if (st->nchunks + 2 > st->offset_cap) {
+    st->offset_cap = 2 * st->offset_cap + 64;
+    off_t *offset = (off_t*) realloc(st->offset, sizeof(off_t) * st->offset_cap);
+    if (offset == NULL) {
+      fprintf(stderr, "cannot allocate the chunk index\n");
+      return -1;
+    }
+    st->offset = offset;
+  }
+  st->offset[++st->nchunks] = pos;
+  return 0;
+}
+
+// record the fingerprint, and the chunk offsets and the bounding box of
+// the lines from st->first on
+static int index_lines(stream_t *st, const int32_t *xyz, size_t n, size_t line, off_t pos) {
+  size_t skip = st->first >= line - 1 + n ? n : st->first > line - 1 ? st->first - (line - 1) : 0;
+  for (size_t ix = 0; ix < n; ++ix) {
+    const int32_t *v = xyz + 3 * ix;
+    for (int dx = 0; dx < 3; ++dx) {
+      if (v[dx] < -COORD_LIMIT || v[dx] > COORD_LIMIT) {
+        cells_range_error(st->path, line + ix);
+        return -1;
+      }
+      if (ix >= skip) {
+        st->lo[dx] = v[dx] < st->lo[dx] ? v[dx] : st->lo[dx];
+        st->hi[dx] = v[dx] > st->hi[dx] ? v[dx] : st->hi[dx];
+      }
+    }
+    st->hash = cells_hash_point(st->hash, v[0], v[1], v[2]);
+  }
+  pos += (off_t) skip * (LINE_LEN + 1);
+  n -= skip;
+  // lines have a fixed length once they decoded
+  for (size_t next = (st->n / st->chunk + 1) * st->chunk; next <= st->n + n; next += st->chunk)
+    if (push_offset(st, pos + (off_t) (next - st->n) * (LINE_LEN + 1)) < 0)
+      return -1;
+  st->n += n;
+  return 0;
+}
+
+// store the lines in the slot being loaded
+static int load_lines(stream_t *st, const int32_t *xyz, size_t n, size_t line, off_t pos) {
+  cells_t *cells = st->slot + st->loading;
+  if (cells->n + n > st->chunk) {
+    fprintf(stderr, "%s changed while reading\n", st->path);
+    return -1;
+  }
+  size_t bad = cells_store(cells, cells->n, xyz, n);
+  if (bad) {
+    cells_range_error(st->path, line + bad - 1);
+    return -1;
+  }
+  cells->n += n;
+  return 0;
+}
+
+// read and decode chunk cx into slot sx
+static int stream_load(stream_t *st, size_t cx, int sx) {
+  st->loading = sx;
+  st->held[sx] = st->nchunks;
+  st->slot[sx].n = 0;
+  if (stream_read(st, st->offset[cx], st->offset[cx + 1], st->first + cx * st->chunk + 1,
+                  load_lines) < 0)
+    return -1;
+  st->held[sx] = cx;
+  return 0;
+}
+
+// the slot holding chunk cx, loading it into the slot other than keep
+// if it is not in memory
+static int stream_get(stream_t *st, size_t cx, int keep) {
+  for (int sx = 0; sx < 2; ++sx)
+    if (st->held[sx] == cx)
+      return sx;
+  int sx = keep == 0 ? 1 : 0;
+  return stream_load(st, cx, sx) < 0 ? -1 : sx;
+}
+
+int stream_open(stream_t *st, const char *path, size_t budget, size_t tile,
+                size_t first, size_t last) {
+  memset(st, 0, sizeof(*st));
+  st->fd = -1;
+  st->path = path;
+  st->tile = tile;
+  st->first = first;
+  st->hash = CELLS_HASH_SEED;
+  // two chunks of int16 coordinates, padding included, fit the budget
+  size_t chunk = budget / (2 * 3 * sizeof(int16_t));
+  chunk = chunk > 2 * CELLS_PAD ? chunk - 2 * CELLS_PAD : CELLS_PAD;
+  st->chunk = chunk > tile ? chunk / tile * tile : chunk;
+  for (int dx = 0; dx < 3; ++dx) {
+    st->lo[dx] = INT16_MAX;
+    st->hi[dx] = INT16_MIN;
+  }
+
+  st->fd = open(path, O_RDONLY);
+  if (st->fd < 0) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  st->buf = (char*) malloc(READ_BUF);
+  st->xyz = (int32_t*) malloc(sizeof(int32_t) * 3 * (READ_BUF / (LINE_LEN + 1) + 1));
+  st->offset_cap = 64;
+  st->offset = (off_t*) malloc(sizeof(off_t) * st->offset_cap);
+  if (st->buf == NULL || st->xyz == NULL || st->offset == NULL) {
+    fprintf(stderr, "cannot allocate the read buffers\n");
+    return -1;
+  }
+  if (cells_alloc(st->slot, st->chunk) < 0 || cells_alloc(st->slot + 1, st->chunk) < 0)
+    return -1;
+
+  // lines have a fixed length, so the range ends at a known offset
+  off_t size = lseek(st->fd, 0, SEEK_END), end = size;
+  if (last <= (size_t) size / (LINE_LEN + 1))
+    end = (off_t) last * (LINE_LEN + 1);
+  size_t lines = (end + LINE_LEN) / (LINE_LEN + 1);
+  st->offset[0] = first < lines ? (off_t) first * (LINE_LEN + 1) : end;
+  if (stream_read(st, 0, end, 1, index_lines) < 0)
+    return -1;
+  // the last chunk ends at the end of the range, with or without newline
+  if (st->n % st->chunk != 0) {
+    if (push_offset(st, end) < 0)
+      return -1;
+  } else if (st->nchunks > 0) {
+    st->offset[st->nchunks] = end;
+  }
+  st->held[0] = st->held[1] = st->nchunks;
+  return 0;
+}
+
+void stream_close(stream_t *st) {
+  if (st->fd >= 0)
+    close(st->fd);
+  free(st->buf);
+  free(st->xyz);
+  free(st->offset);
+  cells_free(st->slot);
+  cells_free(st->slot + 1);
+}
+
+int stream_count(stream_t *st, const bins_t *bins, kernel_fn kernel,
+                 uint64_t *total, uint64_t *pairs) {
+  *pairs = 0;
+  for (size_t ax = 0; ax < st->nchunks; ++ax) {
+    // go backwards if the last chunk is still in memory from the row before
+    int backward = st->held[0] == st->nchunks - 1 || st->held[1] == st->nchunks - 1;
+    size_t first = backward ? st->nchunks - 1 : ax + 1;
+    int keep = st->held[0] == first ? 0 : st->held[1] == first ? 1 : -1;
+    int sa = stream_get(st, ax, keep);
+    if (sa < 0)
+      return -1;
+
+    tiles_t tiles;
+    tiles_self(&tiles, st->slot[sa].n, st->tile);
+    *pairs += tiles_run(&tiles, st->slot + sa, st->slot + sa, bins, kernel, total);
+
+    for (size_t kx = 0; kx + ax + 1 < st->nchunks; ++kx) {
+      size_t bx = backward ? st->nchunks - 1 - kx : ax + 1 + kx;
+      int sb = stream_get(st, bx, sa);
+      if (sb < 0)
+        return -1;
+      tiles_cross(&tiles, st->slot[sa].n, st->slot[sb].n, st->tile);
+      *pairs += tiles_run(&tiles, st->slot + sa, st->slot + sb, bins, kernel, total);
+    }
+  }
+  return 0;
+}
+
+int stream_count_cross(stream_t *a, stream_t *b, const bins_t *bins, kernel_fn kernel,
+                       uint64_t *total, uint64_t *pairs) {
+  *pairs = 0;
+  for (size_t ax = 0; ax < a->nchunks; ++ax) {
+    int sa = stream_get(a, ax, -1);
+    if (sa < 0)
+      return -1;
+    // go backwards if the last chunk of b is still in memory
+    int backward = b->held[0] == b->nchunks - 1 || b->held[1] == b->nchunks - 1;
+    for (size_t kx = 0; kx < b->nchunks; ++kx) {
+      size_t bx = backward ? b->nchunks - 1 - kx : kx;
+      int sb = stream_get(b, bx, -1);
+      if (sb < 0)
+        return -1;
+      tiles_t tiles;
+      tiles_cross(&tiles, a->slot[sa].n, b->slot[sb].n, a->tile);
+      *pairs += tiles_run(&tiles, a->slot + sa, b->slot + sb, bins, kernel, total);
+    }
+  }
+  return 0;
+}
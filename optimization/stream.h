@@ -0,0 +1,55 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "cells.h"
+#include "bins.h"
+#include "kernel.h"
+
+// a cells file, or a range of its lines, counted while holding at most a
+// fixed budget of coordinates in memory
+//
+// the file is split into chunks, two of which fit into the budget; the
+// pairs within every chunk and between every two chunks are counted with
+// the blocked kernel, the order of the chunk pairs alternates direction so
+// that the last chunk of one row is reused by the next
+typedef struct {
+  const char *path;
+  int fd;
+  size_t tile;
+  size_t first;       // line of the file the stream starts at, from 0
+  size_t n;           // number of points
+  uint64_t hash;      // fingerprint of all lines up to the end of the stream
+  int16_t lo[3], hi[3];
+  size_t chunk;       // points per chunk
+  size_t nchunks;
+  off_t *offset;      // file offset of every chunk, nchunks + 1 entries
+  size_t offset_cap;
+  char *buf;
+  int32_t *xyz;       // parsed triples of one buffer
+  cells_t slot[2];    // the chunks in memory
+  size_t held[2];     // chunk held by every slot, nchunks if none
+  int loading;        // slot being loaded
+} stream_t;
+
+// open the file and check and index its lines [first, last) in one pass,
+// which also finds the number of points and their bounding box; the lines
+// before first are read for the fingerprint only
+// returns 0 on success, -1 after printing an error message
+int stream_open(stream_t *st, const char *path, size_t budget, size_t tile,
+                size_t first, size_t last);
+void stream_close(stream_t *st);
+
+// count all pairs into total, pairs is set to the number of pairs given
+// to the kernels
+// returns 0 on success, -1 after printing an error message
+int stream_count(stream_t *st, const bins_t *bins, kernel_fn kernel,
+                 uint64_t *total, uint64_t *pairs);
+
+// count all pairs between the points of a and the points of b
+int stream_count_cross(stream_t *a, stream_t *b, const bins_t *bins, kernel_fn kernel,
+                       uint64_t *total, uint64_t *pairs);
+
+#endif
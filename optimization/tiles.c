@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "omp.h"
+#include "tiles.h"
+
+size_t tiles_default_size(void) {
+  long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  if (l1 <= 0)
+    l1 = 32 * 1024;
+  // a quarter of L1 for one block of three int16 coordinates
+  size_t tile = l1 / (4 * 3 * sizeof(int16_t)) / CELLS_PAD * CELLS_PAD;
+  return tile < 256 ? 256 : tile > 8192 ? 8192 : tile;
+}
+
+static inline size_t nblocks(size_t n, size_t tile) {
+  return (n + tile - 1) / tile;
+}
+
+// number of points in block bx of a set of n points
+static inline size_t block_size(size_t n, size_t tile, size_t bx) {
+  size_t begin = bx * tile;
+  return n - begin < tile ? n - begin : tile;
+}
+
+// pairs of all rows of the blocks before block a
+static inline uint64_t pairs_before(const tiles_t *tiles, size_t a) {
+  uint64_t rows = a * tiles->tile < tiles->na ? a * tiles->tile : tiles->na;
+  if (tiles->self)
+    // row i pairs with the n - 1 - i later points
+    return rows * tiles->na - rows * (rows + 1) / 2;
+  return rows * tiles->nb;
+}
+
+// pairs in the first rows of a diagonal block of n points
+static inline uint64_t diagonal_pairs(uint64_t n, uint64_t rows) {
+  return rows * n - rows * (rows + 1) / 2;
+}
+
+static void tiles_plan(tiles_t *tiles, size_t na, size_t nb, size_t tile, int self) {
+  tiles->na = na;
+  tiles->nb = nb;
+  tiles->tile = tile;
+  tiles->self = self;
+  tiles->pairs = pairs_before(tiles, nblocks(na, tile));
+  tiles->shard = 0;
+  tiles->nshards = 1;
+}
+
+void tiles_self(tiles_t *tiles, size_t n, size_t tile) {
+  tiles_plan(tiles, n, n, tile, 1);
+}
+
+void tiles_cross(tiles_t *tiles, size_t na, size_t nb, size_t tile) {
+  tiles_plan(tiles, na, nb, tile, 0);
+}
+
+// a position is a row r of block a of the first set compared to block b
+// of the second set, find the position of pair p
+static void tiles_locate(const tiles_t *tiles, uint64_t p, size_t *a, size_t *b, size_t *r) {
+  size_t tile = tiles->tile, nba = nblocks(tiles->na, tile);
+  if (p >= tiles->pairs) {
+    *a = nba;
+    *b = tiles->self ? nba : 0;
+    *r = 0;
+    return;
+  }
+  size_t lo = 0, hi = nba;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (pairs_before(tiles, mid) <= p)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  uint64_t off = p - pairs_before(tiles, lo);
+  uint64_t na = block_size(tiles->na, tile, lo);
+  *a = lo;
+  if (tiles->self) {
+    if (off < diagonal_pairs(na, na)) {
+      size_t rlo = 0, rhi = na;
+      while (rhi - rlo > 1) {
+        size_t mid = (rlo + rhi) / 2;
+        if (diagonal_pairs(na, mid) <= off)
+          rlo = mid;
+        else
+          rhi = mid;
+      }
+      *b = lo;
+      *r = rlo;
+      return;
+    }
+    off -= diagonal_pairs(na, na);
+    *b = lo + 1 + off / (na * tile);
+    off -= (*b - lo - 1) * na * tile;
+  } else {
+    *b = off / (na * tile);
+    off -= *b * na * tile;
+  }
+  *r = off / block_size(tiles->nb, tile, *b);
+}
+
+// the pairs before position (a, b, r)
+static uint64_t tiles_index(const tiles_t *tiles, size_t a, size_t b, size_t r) {
+  size_t tile = tiles->tile;
+  if (a >= nblocks(tiles->na, tile))
+    return tiles->pairs;
+  uint64_t p = pairs_before(tiles, a), na = block_size(tiles->na, tile, a);
+  if (tiles->self) {
+    if (b == a)
+      return p + diagonal_pairs(na, r);
+    p += diagonal_pairs(na, na) + (uint64_t) (b - a - 1) * na * tile;
+  } else {
+    p += (uint64_t) b * na * tile;
+  }
+  return p + (uint64_t) r * block_size(tiles->nb, tile, b);
+}
+
+uint64_t tiles_shard(tiles_t *tiles, uint64_t shard, uint64_t nshards) {
+  tiles->shard = shard;
+  tiles->nshards = nshards;
+  // a part starts at the row its first pair is in
+  size_t a, b, r, ea, eb, er;
+  tiles_locate(tiles, tiles->pairs * shard / nshards, &a, &b, &r);
+  tiles_locate(tiles, tiles->pairs * (shard + 1) / nshards, &ea, &eb, &er);
+  return tiles_index(tiles, ea, eb, er) - tiles_index(tiles, a, b, r);
+}
+
+void tiles_count(const tiles_t *tiles, const cells_t *ca, const cells_t *cb,
+                 const bins_t *bins, kernel_fn kernel,
+                 uint64_t part, uint64_t nparts, hist_t *hist) {
+  size_t tile = tiles->tile, nbb = nblocks(tiles->nb, tile);
+  size_t a, b, r, ea, eb, er;
+  tiles_locate(tiles, tiles->pairs * part / nparts, &a, &b, &r);
+  tiles_locate(tiles, tiles->pairs * (part + 1) / nparts, &ea, &eb, &er);
+
+  while (a < ea || (a == ea && (b < eb || (b == eb && r < er)))) {
+    size_t na = block_size(tiles->na, tile, a);
+    size_t begin = b * tile, end = begin + block_size(tiles->nb, tile, b);
+    size_t rows = a == ea && b == eb ? er : na;
+    for (; r < rows; ++r) {
+      size_t ix = a * tile + r;
+      // on a diagonal block only the later points of the block
+      size_t first = tiles->self && a == b ? ix + 1 : begin;
+      hist_reserve(hist, end - first);
+      kernel(bins, ca->x[ix], ca->y[ix], ca->z[ix],
+             cb->x + first, cb->y + first, cb->z + first, end - first, hist);
+    }
+    if (r == na) {
+      r = 0;
+      if (++b == nbb) {
+        ++a;
+        b = tiles->self ? a : 0;
+      }
+    }
+  }
+}
+
+uint64_t tiles_run(const tiles_t *tiles, const cells_t *a, const cells_t *b,
+                   const bins_t *bins, kernel_fn kernel, uint64_t *total) {
+  hist_t *hists[omp_get_max_threads()];
+  int failed = 0;
+  uint64_t pairs = 0;
+#pragma omp parallel reduction(+: pairs)
+  {
+    // every thread allocates and first touches its own histogram
+    int thrd = omp_get_thread_num(), nthrds = omp_get_num_threads();
+    hist_t hist;
+    hists[thrd] = &hist;
+    if (hist_init(&hist, bins->nbins) < 0) {
+#pragma omp atomic write
+      failed = 1;
+    } else {
+      tiles_count(tiles, a, b, bins, kernel, tiles->shard * nthrds + thrd,
+                  tiles->nshards * nthrds, &hist);
+      hist_flush(&hist);
+      pairs = hist.pairs;
+    }
+#pragma omp barrier
+    // every thread sums a slice of the bins over all threads
+    if (!failed)
+      hist_reduce(hists, nthrds, thrd, total);
+#pragma omp barrier
+    hist_free(&hist);
+  }
+  if (failed) {
+    fprintf(stderr, "cannot allocate the thread histograms\n");
+    return 0;
+  }
+  return pairs;
+}
@@ -0,0 +1,54 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cells.h"
+#include "bins.h"
+#include "kernel.h"
+#include "hist.h"
+
+// the points are split into blocks of tile points and the pairs are
+// traversed block pair by block pair so that the inner block stays in L1
+// while every point of the outer block is compared to it
+//
+// for the pairs within one set only the upper triangle of block pairs
+// (a, b), a <= b, is visited, for two sets all block pairs are visited
+//
+// nothing is stored per block pair, the number of pairs before every
+// position is computed directly so the pairs can be split evenly, between
+// the threads and between the shards run by separate processes
+typedef struct {
+  size_t na, nb;      // number of points of the two sets
+  size_t tile;        // points per block
+  int self;           // pairs within one set, na == nb
+  uint64_t pairs;     // total number of pairs
+  uint64_t shard, nshards; // the part of the pairs counted
+} tiles_t;
+
+// block size that keeps two blocks and the histogram in L1
+size_t tiles_default_size(void);
+
+// plan the pairs within one set of n points
+void tiles_self(tiles_t *tiles, size_t n, size_t tile);
+// plan the pairs between a set of na and a set of nb points
+void tiles_cross(tiles_t *tiles, size_t na, size_t nb, size_t tile);
+
+// count only the pairs of shard out of nshards, part shard * nthrds + thrd
+// out of nshards * nthrds is thread thrd's, so the shard covers the same
+// pairs for any number of threads
+// returns the number of pairs in the shard
+uint64_t tiles_shard(tiles_t *tiles, uint64_t shard, uint64_t nshards);
+
+// count the pairs of part out of nparts, all parts cover the same number
+// of pairs up to one row of a block
+void tiles_count(const tiles_t *tiles, const cells_t *a, const cells_t *b,
+                 const bins_t *bins, kernel_fn kernel,
+                 uint64_t part, uint64_t nparts, hist_t *hist);
+
+// count all pairs with the current OpenMP threads and add them to total
+// returns the number of pairs given to the kernels
+uint64_t tiles_run(const tiles_t *tiles, const cells_t *a, const cells_t *b,
+                   const bins_t *bins, kernel_fn kernel, uint64_t *total);
+
+#endif